@@ -27,25 +27,83 @@
 #ifndef TINY_BASIC_PROGRAM_HPP
 #define TINY_BASIC_PROGRAM_HPP
 
+// compiling to bytecode starts from the AST
+#if defined(JAK_BYTECODE) && !defined(JAK_AST)
+# define JAK_AST
+#endif
+
 #include <bits/buffer.hpp>
 #include <bits/validate.hpp>
+#include <bits/lexer.hpp>
+#include <bits/profile.hpp>
+#include <bits/ast.hpp>
 #include <bits/parser.hpp>
+#ifdef JAK_BYTECODE
+# include <bits/fold.hpp>
+# include <bits/cfg.hpp>
+# include <bits/bytecode.hpp>
+#endif
 
 struct TinyBasicProgram
 {
     char const* source;
+#ifdef JAK_BYTECODE
+    // the program compiled, for vm.hpp
+    Jak::BytecodeView code;
+#endif
 
     TinyBasicProgram(char const* s)
         : source(s)
+#ifdef JAK_BYTECODE
+          , code{nullptr, s}
+#endif
+    {}
+
+#ifdef JAK_BYTECODE
+    TinyBasicProgram(char const* s, Jak::BytecodeView c)
+        : source(s)
+          , code(c)
     {}
+#endif
 };
 
-#define TinyBasic(S)\
+#ifdef JAK_BYTECODE
+// The program is checked and compiled from its tree once its constants
+// are folded and its unreachable lines marked; its jumps to a literal
+// are gathered as it parses and checked as well. The tree is built twice, once for the plan and once
+// for the bytecode, but never kept, and the sizes the plan works out are
+// not worked out again. The bytecode is a constant of a lambda of its
+// own, so that it ends up in .rodata, with nothing left to do at startup.
+# define TinyBasic(S)\
+    ([]{\
+        constexpr auto plan =\
+            Jak::bytecode_plan<sizeof(S), Jak::line_bound(Jak::Buf(S))>(Jak::Buf(S));\
+        Jak::SyntaxCheckPacked<plan.result>();\
+        static constexpr auto bytecode =\
+            Jak::compile<plan.words, sizeof(S), Jak::line_bound(Jak::Buf(S))>(Jak::Buf(S), plan.sizes);\
+        return TinyBasicProgram(S, Jak::BytecodeView{bytecode.words, S});\
+     }())
+#else
+// The program is checked as it is parsed, and its GOTO and GOSUB to a
+// literal line number against its lines; nothing is folded, so the
+// errors that only folding finds need JAK_BYTECODE: a DivisionByZero,
+// as in 10 PRINT 1/0, and a jump to a line that a constant expression
+// names, as in 10 GOTO 5*3, both compile here.
+# define TinyBasic(S)\
     ((\
-      Jak::SyntaxCheckHelper<\
-            (Jak::TinyBasicParser(Jak::Buf(S)).file()).code(),\
-            (Jak::TinyBasicParser(Jak::Buf(S)).file()).lineNo()>()\
+      Jak::SyntaxCheckPacked<Jak::checked_file<Jak::line_bound(Jak::Buf(S))>(Jak::Buf(S))>()\
       ),\
      TinyBasicProgram(S))
+#endif
+
+#ifdef JAK_PROFILE
+// a Jak::Profile of the program, usable in constant expressions
+# define TinyBasicProfile(S) (Jak::profile(Jak::Buf(S)))
+#endif
+
+#ifdef JAK_AST
+// a Jak::Ast of the program, usable in constant expressions
+# define TinyBasicAst(S) (Jak::ast<sizeof(S)>(Jak::Buf(S)))
+#endif
 
 #endif
@@ -0,0 +1,300 @@
+#if 0
+goal: see how the cost of validating embedded programs at compile time
+      scales with their size and shape
+compile with g++ --std=gnu++14 -O2 bench/compile.cpp -o compile
+run from the top of the tree: ./compile [--quick] [--no-limits] [--bytecode] [--cxx g++] > compile.csv
+
+Linux only (fork, execvp, wait4). For every generated program it writes
+a translation unit that goes through TinyBasic(S), compiles it with
+-fsyntax-only and records, as CSV on stdout:
+
+    series,param,bytes,lines,default_ok,wall_s,max_rss_kb,ops_limit,depth_limit
+
+default_ok  whether it builds with the default constexpr limits of the compiler
+wall_s      wall time of the compiler with generous limits
+max_rss_kb  peak RSS of the compiler (the largest of the driver and cc1plus)
+ops_limit   smallest -fconstexpr-ops-limit that works, within 5%
+depth_limit smallest -fconstexpr-depth that works
+
+With --bytecode the programs are compiled to bytecode as well, the way
+TinyBasic(S) does with JAK_BYTECODE defined.
+
+The series vary one thing at a time: the number of lines of a mixed
+program, the nesting of parentheses in an expression, the length of the
+strings, and which keyword every line uses.
+#endif
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "corpus.hpp"
+
+namespace {
+
+char const* cxx = "g++";
+bool bytecode = false;
+
+struct Program
+{
+    std::string series;
+    std::string param;
+    std::string source;
+};
+
+std::string numbered(unsigned n, std::string const& statement)
+{
+    return std::to_string(n * 10) + " " + statement + "\n";
+}
+
+std::string nested(unsigned depth)
+{
+    return numbered(1, "LET X = " + std::string(depth, '(') + "1"
+            + std::string(depth, ')') + " + A");
+}
+
+std::string strings(unsigned length)
+{
+    std::string s;
+    for(unsigned i = 1; i <= 100; ++i) {
+        s += numbered(i, "PRINT \"" + std::string(length, 'x') + "\", X");
+    }
+    return s;
+}
+
+std::string keyword(char const* statement)
+{
+    std::string s;
+    for(unsigned i = 1; i <= 500; ++i) s += numbered(i, statement);
+    return s;
+}
+
+std::vector<Program> programs(bool quick)
+{
+    std::vector<Program> ret;
+
+    std::vector<unsigned> sizes = { 100, 250, 500, 1000, 2000, 4000 };
+    if(quick) sizes = { 100, 500 };
+    for(unsigned n : sizes) ret.push_back({ "lines", std::to_string(n), program(&mixed, n) });
+
+    std::vector<unsigned> depths = { 8, 32, 64, 128, 256 };
+    if(quick) depths = { 8, 64 };
+    for(unsigned d : depths) ret.push_back({ "depth", std::to_string(d), nested(d) });
+
+    std::vector<unsigned> lengths = { 10, 100, 1000 };
+    if(quick) lengths = { 10, 100 };
+    for(unsigned l : lengths) ret.push_back({ "strings", std::to_string(l), strings(l) });
+
+    static char const* const keywords[][2] = {
+        { "PRINT", "PRINT \"A\", B, C" },
+        { "LET", "LET X = A + B * C" },
+        { "IF", "IF A < B THEN GOTO 10" },
+        { "GOTO", "GOTO 10" },
+        { "INPUT", "INPUT A, B, C" },
+        { "END", "END" },
+    };
+    unsigned const n = quick ? 2 : sizeof(keywords) / sizeof(keywords[0]);
+    for(unsigned i = 0; i != n; ++i) {
+        ret.push_back({ "keyword", keywords[i][0], keyword(keywords[i][1]) });
+    }
+
+    return ret;
+}
+
+// the program as a C++ string literal, one source line per literal line
+std::string literal(std::string const& source)
+{
+    std::string s = "\"";
+    for(char c : source) {
+        switch(c)
+        {
+        case '\n': s += "\\n\"\n\""; break;
+        case '"': s += "\\\""; break;
+        case '\\': s += "\\\\"; break;
+        default: s += c; break;
+        }
+    }
+    return s + "\"";
+}
+
+std::string translation_unit(std::string const& source)
+{
+    return std::string(bytecode ? "#define JAK_BYTECODE\n" : "")
+        + "#include <TinyBasicProgram.hpp>\n"
+        "#include <TestUtils.h>\n"
+        "int main()\n{\n    Execute(TinyBasic(" + literal(source) + "));\n}\n";
+}
+
+struct Run
+{
+    bool ok;
+    double wall;
+    long max_rss_kb;
+};
+
+Run compile(char const* path, std::vector<std::string> const& flags)
+{
+    std::vector<std::string> args = {
+        cxx, "--std=gnu++14", "-I.", "-I./bits", "-DTEST_NAME=bench",
+        "-fsyntax-only", "-x", "c++", path };
+    args.insert(args.end(), flags.begin(), flags.end());
+    std::vector<char*> argv;
+    for(auto&& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+
+    auto const start = std::chrono::steady_clock::now();
+    pid_t const pid = fork();
+    if(pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if(pid == 0) {
+        int const null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        exit(1);
+    }
+    auto const end = std::chrono::steady_clock::now();
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+        fprintf(stderr, "could not run %s\n", cxx);
+        exit(1);
+    }
+
+    return {
+        WIFEXITED(status) && WEXITSTATUS(status) == 0,
+        std::chrono::duration<double>(end - start).count(),
+        usage.ru_maxrss };
+}
+
+std::string flag(char const* name, unsigned long value)
+{
+    return std::string(name) + "=" + std::to_string(value);
+}
+
+unsigned long const generous_ops = 2000000000;
+unsigned long const generous_depth = 100000;
+unsigned long const generous_loops = 100000000;
+
+// The smallest value in [first, most] for which works() holds, to within
+// a factor of precision: grow geometrically until it works, then bisect
+// between the last failure and the first success. Limits span orders of
+// magnitude, so both steps work on a log scale. 0 if nothing works.
+template<typename Works>
+unsigned long smallest(Works works, unsigned long first, unsigned long most, double precision)
+{
+    unsigned long lo = 0, hi = first;
+    while(!works(hi)) {
+        if(hi == most) return 0;
+        lo = hi;
+        hi = hi * 4 < most ? hi * 4 : most;
+    }
+    while(hi > lo + 1 && hi > lo * precision) {
+        unsigned long mid = lo ? static_cast<unsigned long>(std::sqrt(double(lo) * hi)) : hi / 2;
+        if(mid <= lo) mid = lo + 1;
+        if(mid >= hi) break;
+        if(works(mid)) hi = mid;
+        else lo = mid;
+    }
+    return hi;
+}
+
+unsigned long ops_limit(char const* path)
+{
+    return smallest([path](unsigned long ops) {
+            return compile(path, {
+                    flag("-fconstexpr-ops-limit", ops),
+                    flag("-fconstexpr-depth", generous_depth),
+                    flag("-fconstexpr-loop-limit", generous_loops) }).ok;
+            }, 100000, generous_ops, 1.05);
+}
+
+unsigned long depth_limit(char const* path)
+{
+    return smallest([path](unsigned long depth) {
+            return compile(path, {
+                    flag("-fconstexpr-ops-limit", generous_ops),
+                    flag("-fconstexpr-depth", depth),
+                    flag("-fconstexpr-loop-limit", generous_loops) }).ok;
+            }, 16, generous_depth, 1.0);
+}
+
+unsigned count_lines(std::string const& s)
+{
+    unsigned n = 0;
+    for(char c : s) n += (c == '\n');
+    return n;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool quick = false;
+    bool limits = true;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--quick") == 0) quick = true;
+        else if(strcmp(argv[i], "--no-limits") == 0) limits = false;
+        else if(strcmp(argv[i], "--bytecode") == 0) bytecode = true;
+        else if(strcmp(argv[i], "--cxx") == 0 && i + 1 < argc) cxx = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--quick] [--no-limits] [--bytecode] [--cxx compiler]\n", argv[0]);
+            return 255;
+        }
+    }
+
+    char path[] = "/tmp/jak-bench-XXXXXX";
+    int const fd = mkstemp(path);
+    if(fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    printf("series,param,bytes,lines,default_ok,wall_s,max_rss_kb,ops_limit,depth_limit\n");
+    for(auto&& p : programs(quick)) {
+        FILE* f = fopen(path, "w");
+        if(!f) {
+            perror(path);
+            return 1;
+        }
+        std::string const tu = translation_unit(p.source);
+        fwrite(tu.data(), 1, tu.size(), f);
+        fclose(f);
+
+        Run const plain = compile(path, {});
+        Run const run = compile(path, {
+                flag("-fconstexpr-ops-limit", generous_ops),
+                flag("-fconstexpr-depth", generous_depth),
+                flag("-fconstexpr-loop-limit", generous_loops) });
+        printf("%s,%s,%zu,%u,%d,%.3f,%ld,%lu,%lu\n",
+                p.series.c_str(),
+                p.param.c_str(),
+                p.source.size(),
+                count_lines(p.source),
+                plain.ok,
+                run.wall,
+                run.max_rss_kb,
+                limits && run.ok ? ops_limit(path) : 0,
+                limits && run.ok ? depth_limit(path) : 0);
+        fflush(stdout);
+    }
+
+    unlink(path);
+}
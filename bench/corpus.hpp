@@ -0,0 +1,96 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef BENCH_CORPUS_HPP
+#define BENCH_CORPUS_HPP
+
+#include <chrono>
+#include <string>
+
+// What the benches parse: generated programs, made of the lines that a
+// corpus makes for each line number, 10, 20 and so on.
+struct Corpus
+{
+    char const* name;
+    std::string (*line)(unsigned);
+};
+
+// a bit of every statement, in turn
+inline std::string mixed(unsigned i)
+{
+    static char const* const statements[] = {
+        "PRINT 'Hello, World!', X",
+        "LET X = (X + 1) * 2 - Y / 3",
+        "IF X < 10 THEN GOTO 10",
+        "INPUT A, B, C",
+        "GOSUB 100",
+        "RETURN",
+        "DATA 1, 2, 3",
+    };
+    return std::to_string(i) + " " + statements[i % 7] + "\n";
+}
+
+// a string and an expression are tried for every element of the list
+inline std::string print_lists(unsigned i)
+{
+    return std::to_string(i) + " PRINT \"A\", (B + C) * D, 'E', F, -G, \"H\", "
+        + std::to_string(i) + "\n";
+}
+
+// the first n lines of a corpus
+inline std::string program(std::string (*line)(unsigned), unsigned n)
+{
+    std::string s;
+    for(unsigned i = 1; i <= n; ++i) s += line(i * 10);
+    return s;
+}
+
+// at least bytes of a corpus, in whole lines, and how many lines that is
+inline std::string program(Corpus const& c, size_t bytes, unsigned& lines)
+{
+    std::string s;
+    lines = 0;
+    while(s.size() < bytes) s += c.line(++lines * 10);
+    return s;
+}
+
+// run() over and over for half a second; the seconds of the fastest run
+template<typename Run>
+double best_time(Run const& run)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double best = 1e9;
+    auto const start = Clock::now();
+    while(std::chrono::duration<double>(Clock::now() - start).count() < 0.5) {
+        auto const t0 = Clock::now();
+        run();
+        double const t = std::chrono::duration<double>(Clock::now() - t0).count();
+        if(t < best) best = t;
+    }
+    return best;
+}
+
+#endif
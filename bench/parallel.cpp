@@ -0,0 +1,112 @@
+#if 0
+goal: check that validate() of bits/parallel.hpp gives what file() gives,
+      and see how its throughput grows with the number of threads
+compile with g++ --std=gnu++14 -O2 -pthread -I. -I./bits bench/parallel.cpp -o parallel
+run as ./parallel [most threads]
+
+Each corpus is a generated program of about 4MiB, some of them with
+strings that run over several lines. First every corpus, and copies of
+it with an error put in at a few places, go through validate() with 1,
+2, 4 and 8 threads and the results are compared with file(). Then the
+clean corpus is validated over and over for half a second per thread
+count and the best run is reported.
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#define CONSTEXPR
+#include "buffer.hpp"
+#include "validate.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "parallel.hpp"
+#include "corpus.hpp"
+
+using namespace Jak;
+
+// every third line has a string over three lines that look like lines
+// of their own
+static std::string long_strings(unsigned i)
+{
+    if(i % 3 == 1) return std::to_string(i) + " LET A = B + " + std::to_string(i) + "\n";
+    if(i % 3 == 2) return std::to_string(i) + " PRINT 'one\n20 PRINT X\n30 GOTO 10', X\n";
+    return std::to_string(i) + " PRINT \"one\n20 LET A = 1\n30 RETURN\", X\n";
+}
+
+static Corpus const corpora[] = {
+    { "mixed", &mixed },
+    { "long-strings", &long_strings },
+    { "print-lists", &print_lists },
+};
+
+// errors to put in, each one just after a newline
+static char const* const errors[] = {
+    "10 PRONT X\n",
+    "10 LET X = (1\n",
+    "10 PRINT \"runaway\n",
+    "10 PRINT 'odd\" and \"even'\n",
+};
+
+static bool check(char const* name, std::string const& source)
+{
+    Buf const buf(source.c_str(), static_cast<unsigned>(source.size()));
+    unsigned long long const expected = TinyBasicParser(buf).file().result();
+    for(unsigned threads : { 1u, 2u, 4u, 8u }) {
+        unsigned long long const got = validate(buf, threads);
+        if(got != expected) {
+            printf("%s with %u threads: code %d on line %d, file() has code %d on line %d\n",
+                    name, threads,
+                    static_cast<int>(UnpackCode(got)), UnpackLine(got),
+                    static_cast<int>(UnpackCode(expected)), UnpackLine(expected));
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned most = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 0;
+    if(most == 0) most = std::thread::hardware_concurrency();
+    if(most == 0) most = 1;
+
+    bool ok = true;
+    for(auto&& c : corpora) {
+        unsigned lines = 0;
+        std::string const source = program(c, 4 * 1024 * 1024, lines);
+        if(TinyBasicParser(Buf(source.c_str(), static_cast<unsigned>(source.size()))).file().code() != Code::Okay) {
+            printf("%s does not parse\n", c.name);
+            return 1;
+        }
+        ok = check(c.name, source) && ok;
+        for(auto&& e : errors) {
+            for(unsigned n : { 1u, 3u, 7u }) {
+                std::string s = source;
+                s.insert(s.find('\n', s.size() / 8 * n) + 1, e);
+                ok = check(c.name, s) && ok;
+            }
+        }
+    }
+    if(!ok) return 1;
+
+    printf("%-14s %8s %8s %10s %8s\n", "corpus", "KiB", "threads", "MiB/s", "speedup");
+    for(auto&& c : corpora) {
+        unsigned lines = 0;
+        std::string const source = program(c, 4 * 1024 * 1024, lines);
+        Buf const buf(source.c_str(), static_cast<unsigned>(source.size()));
+
+        double one = 0;
+        for(unsigned threads = 1; threads <= most; threads *= 2) {
+            double const best = best_time([&]() { validate(buf, threads); });
+            if(threads == 1) one = best;
+            printf("%-14s %8zu %8u %10.1f %8.2f\n",
+                    c.name,
+                    source.size() / 1024,
+                    threads,
+                    source.size() / best / (1024 * 1024),
+                    one / best);
+        }
+    }
+}
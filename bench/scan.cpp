@@ -0,0 +1,95 @@
+#if 0
+goal: parse throughput with and without the scanning code of bits/scan.hpp
+compile with g++ --std=gnu++14 -O2 -I. -I./bits bench/scan.cpp -o simd
+         and g++ --std=gnu++14 -O2 -I. -I./bits -DJAK_NO_SIMD bench/scan.cpp -o plain
+
+Each corpus is a generated program of about 1MiB that parses without
+errors. It is parsed over and over for half a second and the best run is
+reported, once for each routine the processor supports for the rest of
+long strings. The corpora lean on one kind of run each: blanks, digits
+or strings, plus a mixed one.
+#endif
+#include <cstdio>
+#include <string>
+
+#define CONSTEXPR
+#include "scan.hpp"
+#include "buffer.hpp"
+#include "validate.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "corpus.hpp"
+
+using namespace Jak;
+
+static std::string indented(unsigned i)
+{
+    std::string const pad(24, ' ');
+    return std::to_string(i) + pad + "LET" + pad + "X" + pad + "=" + pad + "A"
+        + pad + "+" + pad + "B\n";
+}
+
+static std::string numbers(unsigned i)
+{
+    return std::to_string(i) + " DATA 31415926535897932384, 27182818284590452353,"
+        " 14142135623730950488\n";
+}
+
+static std::string strings(unsigned i)
+{
+    return std::to_string(i) + " PRINT \"The quick brown fox jumps over the lazy dog,"
+        " then over the next one\", X\n";
+}
+
+static Corpus const corpora[] = {
+    { "indented", &indented },
+    { "numbers", &numbers },
+    { "strings", &strings },
+    { "mixed", &mixed },
+};
+
+// the routines to compare; the plain loops do not use any of them
+static Scan::Isa const isas[] = {
+#ifndef JAK_NO_SIMD
+    Scan::Isa::Scalar,
+    Scan::Isa::SSE2,
+#endif
+    Scan::Isa::AVX2,
+};
+
+int main()
+{
+    printf("%-10s %8s", "corpus", "KiB");
+    for(Scan::Isa isa : isas) {
+#ifdef JAK_NO_SIMD
+        (void)isa;
+        printf(" %8s", "plain");
+#else
+        if(Scan::select(isa) == isa) printf(" %8s", Scan::name(isa));
+#endif
+    }
+    printf("  (MiB/s)\n");
+
+    for(auto&& c : corpora) {
+        unsigned lines = 0;
+        std::string const source = program(c, 1024 * 1024, lines);
+
+        Buf const buf(source.c_str(), static_cast<unsigned>(source.size()));
+        if(TinyBasicParser(buf).file().code() != Code::Okay) {
+            printf("%-10s does not parse\n", c.name);
+            return 1;
+        }
+
+        printf("%-10s %8zu", c.name, source.size() / 1024);
+        for(Scan::Isa isa : isas) {
+#ifdef JAK_NO_SIMD
+            (void)isa;
+#else
+            if(Scan::select(isa) != isa) continue;
+#endif
+            double const best = best_time([&]() { TinyBasicParser(buf).file(); });
+            printf(" %8.1f", source.size() / best / (1024 * 1024));
+        }
+        printf("\n");
+    }
+}
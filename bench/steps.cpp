@@ -0,0 +1,37 @@
+#if 0
+goal: count how many parser steps each of the bits/test_cases.hpp cases takes
+compile with g++ --std=gnu++14 -I. -I./bits bench/steps.cpp
+
+Every TRACE/DTRACE site in bits/parser.hpp marks one step of a rule, so
+counting them in the runtime build gives a rough measure of the work the
+constexpr evaluator has to do for the same input. Compare the totals
+between two revisions to see what a grammar change saves. The stream
+cases are parsed whole here.
+#endif
+#include <cstdio>
+
+static unsigned long steps = 0;
+
+#define CONSTEXPR
+#define TRACE(F, ...) (++steps)
+#define DTRACE(F, ...) (++steps)
+#include "buffer.hpp"
+#include "validate.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "test_cases.hpp"
+
+using namespace Jak;
+
+int main()
+{
+    unsigned long total = 0;
+    printf("%-24s %8s %8s\n", "case", "bytes", "steps");
+    for(auto&& c : test_cases) {
+        steps = 0;
+        TinyBasicParser(c.buf()).file();
+        total += steps;
+        printf("%-24s %8u %8lu\n", c.name, c.len, steps);
+    }
+    printf("%-24s %8s %8lu\n", "total", "", total);
+}
@@ -0,0 +1,250 @@
+#if 0
+goal: how fast the runtime parser is, on ordinary programs and on ones
+      that push a single rule, next to the combinator parser of
+      experiments/error.cpp
+compile with g++ --std=gnu++14 -O2 -I. -I./bits bench/throughput.cpp -o throughput
+run as ./throughput [seconds per corpus]
+
+Each corpus is a generated program of about 256KiB that parses without
+errors. It is parsed a few times to warm up, then over and over for the
+given time (1s by default, and at least 10 runs). For every corpus this
+prints the median and the spread (median absolute deviation) of the
+runs as MiB/s, the lines per second, the heap allocations per run and,
+on x86, the time stamp counter ticks per byte of the median run.
+
+Two corpora go through the places where the parser could backtrack on
+every line: unnumbered lines make numbered_line() fail before
+unnumbered_line() runs, and nested IFs stack up conditions. A packrat
+memo table in front of the alternatives of first_of() was measured on
+those, print-lists and mixed: it had 0 hits and 43M misses and made
+parsing 15-42% slower, as no rule is ever applied twice at the same
+offset. It was dropped again; should a grammar change add real
+backtracking, these are the corpora where it would show up first.
+
+experiments/error.cpp only knows "let" followed by single letters, so it
+only takes the short INPUT lists: every INPUT A, B, C line becomes
+"let a b c" and gets parsed on its own, the way that parser wants it.
+It copies what is left of its input at every step, which makes it
+quadratic in the length of a line, so it does not get the long lists,
+and only the first 32KiB of the short ones. It is built from the
+experiment as it is, with its main() renamed.
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define TICKS() __rdtsc()
+#endif
+
+#define CONSTEXPR
+#include "scan.hpp"
+#include "buffer.hpp"
+#include "validate.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "corpus.hpp"
+
+namespace Combinator {
+#define main experiment_main
+#include "../experiments/error.cpp"
+#undef main
+}
+
+using namespace Jak;
+
+// every allocation of the process, to see what a parse asks of the heap
+static unsigned long allocations = 0;
+
+void* operator new(size_t n)
+{
+    ++allocations;
+    if(void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+// not inlined, so that the compiler does not take the free() below for
+// one of memory that came from new
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+static std::string unnumbered(unsigned i)
+{
+    return "PRINT A, B, C + " + std::to_string(i % 10) + "\n";
+}
+
+static std::string nested_ifs(unsigned i)
+{
+    return std::to_string(i) + " IF A < B THEN IF (A + 1) * 2 >= C THEN"
+        " IF D <> E THEN PRINT \"deep\", X\n";
+}
+
+static std::string long_strings(unsigned i)
+{
+    return std::to_string(i) + " PRINT \"" + std::string(2000, 'x') + "\", X\n";
+}
+
+static std::string deep_parens(unsigned i)
+{
+    return std::to_string(i) + " LET X = " + std::string(200, '(') + "A + 1"
+        + std::string(200, ')') + "\n";
+}
+
+static std::string input_short(unsigned i)
+{
+    return std::to_string(i) + " INPUT A, B, C, D, E, F, G, H\n";
+}
+
+static std::string input_lists(unsigned i)
+{
+    std::string s = std::to_string(i) + " INPUT A";
+    for(unsigned v = 1; v != 500; ++v) s += std::string(", ") + static_cast<char>('A' + v % 26);
+    return s + "\n";
+}
+
+static std::string long_print_lists(unsigned i)
+{
+    std::string s = std::to_string(i) + " PRINT \"A\"";
+    for(unsigned e = 1; e != 200; ++e) {
+        s += e % 2 ? ", (B + " + std::to_string(e) + ") * C" : ", \"D\"";
+    }
+    return s + "\n";
+}
+
+static Corpus const corpora[] = {
+    { "mixed", &mixed },
+    { "unnumbered", &unnumbered },
+    { "nested-ifs", &nested_ifs },
+    { "long-strings", &long_strings },
+    { "deep-parens", &deep_parens },
+    { "input-short", &input_short },
+    { "input-lists", &input_lists },
+    { "print-lists", &print_lists },
+    { "long-prints", &long_print_lists },
+};
+
+struct Stats
+{
+    double median;
+    double spread;
+    unsigned long allocations;
+    double ticks;
+    unsigned runs;
+};
+
+// runs parse() over and over and times it; parse() returns false if the
+// input does not parse
+template<typename Parse>
+static Stats measure(Parse const& parse, double seconds)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    for(unsigned i = 0; i != 3; ++i) {
+        if(!parse()) {
+            printf("does not parse\n");
+            exit(1);
+        }
+    }
+
+    std::vector<double> times;
+    std::vector<double> ticks;
+    unsigned long const before = allocations;
+    auto const start = Clock::now();
+    while(times.size() < 10 || std::chrono::duration<double>(Clock::now() - start).count() < seconds) {
+        auto const t0 = Clock::now();
+#ifdef TICKS
+        unsigned long long const c0 = TICKS();
+#endif
+        parse();
+#ifdef TICKS
+        ticks.push_back(static_cast<double>(TICKS() - c0));
+#endif
+        times.push_back(std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    unsigned long const allocated = allocations - before;
+
+    auto median = [](std::vector<double> v) {
+        if(v.empty()) return 0.0;
+        std::sort(v.begin(), v.end());
+        return v[v.size() / 2];
+    };
+    double const m = median(times);
+    std::vector<double> deviations;
+    for(double t : times) deviations.push_back(std::fabs(t - m));
+    return { m, median(deviations), allocated / times.size(), median(ticks),
+        static_cast<unsigned>(times.size()) };
+}
+
+static void print(char const* parser, char const* corpus, size_t bytes, unsigned lines, Stats const& s)
+{
+    double const mib = bytes / (1024.0 * 1024.0);
+    printf("%-12s %-13s %6zu %7u %9.1f %6.1f%% %12.0f %8lu",
+            parser, corpus, bytes / 1024, lines, mib / s.median,
+            100 * s.spread / s.median, lines / s.median, s.allocations);
+    if(s.ticks > 0) printf(" %9.2f", s.ticks / bytes);
+    else printf(" %9s", "-");
+    printf(" %6u\n", s.runs);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    double const seconds = argc > 1 ? atof(argv[1]) : 1.0;
+
+    printf("%-12s %-13s %6s %7s %9s %7s %12s %8s %9s %6s\n",
+            "parser", "corpus", "KiB", "lines", "MiB/s", "+-", "lines/s", "allocs", "ticks/B", "runs");
+    for(auto&& c : corpora) {
+        unsigned lines = 0;
+        std::string const source = program(c, 256 * 1024, lines);
+
+        Buf const buf(source.c_str(), static_cast<unsigned>(source.size()));
+        Stats const s = measure([&]() {
+                return TinyBasicParser(buf).file().code() == Code::Okay;
+                }, seconds);
+        print("jak", c.name, source.size(), lines, s);
+
+        if(c.line != &input_short) continue;
+
+        // the same lists as the combinator parser takes them
+        std::vector<std::deque<char>> inputs;
+        size_t bytes = 0;
+        unsigned short_lines = 0;
+        while(bytes < 32 * 1024) {
+            std::string const l = c.line(++short_lines * 10);
+            std::string in = "let";
+            for(size_t k = l.find("INPUT") + 5; k < l.size(); ++k) {
+                if(l[k] >= 'A' && l[k] <= 'Z') in += std::string(" ") + static_cast<char>(l[k] - 'A' + 'a');
+            }
+            bytes += in.size();
+            inputs.emplace_back(in.begin(), in.end());
+        }
+        auto const p = Combinator::Many(Combinator::Or(
+                    Combinator::And(Combinator::And(Combinator::BindParser(Combinator::let),
+                            Combinator::Many(Combinator::BindParser(Combinator::var))),
+                        Combinator::BindParser(Combinator::eof)),
+                    Combinator::And(Combinator::BindParser(Combinator::var),
+                        Combinator::BindParser(Combinator::eof))));
+        Stats const e = measure([&]() {
+                bool ok = true;
+                for(auto&& in : inputs) ok = Combinator::Return(p(in)) && ok;
+                return ok;
+                }, seconds);
+        print("error.cpp", c.name, bytes, short_lines, e);
+    }
+}
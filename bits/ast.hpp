@@ -0,0 +1,213 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef AST_HPP
+#define AST_HPP
+
+#ifndef CONSTEXPR
+# define CONSTEXPR constexpr
+#endif
+
+namespace Jak {
+
+// What the parser builds with JAK_AST defined: a flat tree of 16 byte
+// nodes in one array, linked by 32-bit indices, which point at the
+// source rather than copying any of it. Every node has its first child
+// in child and its next sibling in next; the leaves have their length in
+// child instead. Children come before their parents in the array, as the
+// parser only adds a node once all of it has been read.
+enum class AstKind : unsigned char {
+    // op: 1 for a numbered line, plus 2 for one that cfg.hpp found no way
+    // to; child: the line number, then the statement
+    Line,
+    // op: the Keyword; child: the expression of GOTO and GOSUB, the List
+    // of PRINT, DATA and INPUT, the Var then the expression of LET, the
+    // Relop then the statement after THEN of IF, and nothing otherwise
+    Statement,
+    // child: the items, strings or expressions, or variables for INPUT;
+    // offset: right after the keyword
+    List,
+    // op: an AstRelop; child: the left, then the right expression
+    Relop,
+    // op: '+', '-', '*' or '/'; child: the left, then the right operand
+    Binary,
+    // a leading '-'; child: the operand
+    Negate,
+    // child: the number of digits
+    Number,
+    // child: 1
+    Var,
+    // offset and child: the text between the quotes
+    String,
+    // an expression or IF condition folded by fold.hpp; child: its value
+    Constant
+};
+
+// the lexer also takes << and >>, which mean what < and > do
+enum class AstRelop : unsigned char {
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    Eq,
+    Ne
+};
+
+CONSTEXPR AstRelop relop(Token const t)
+{
+    char const second = t.end - t.begin == 2 ? t.begin[1] : *t.begin;
+    switch(*t.begin)
+    {
+    case '<':
+        return second == '=' ? AstRelop::Le : second == '>' ? AstRelop::Ne : AstRelop::Lt;
+    case '>':
+        return second == '=' ? AstRelop::Ge : second == '<' ? AstRelop::Ne : AstRelop::Gt;
+    default:
+        return AstRelop::Eq;
+    }
+}
+
+// whether a r b holds, as a Value
+CONSTEXPR Value compare(AstRelop const r, Value const a, Value const b)
+{
+    switch(r)
+    {
+    case AstRelop::Lt: return a < b;
+    case AstRelop::Le: return a <= b;
+    case AstRelop::Gt: return a > b;
+    case AstRelop::Ge: return a >= b;
+    case AstRelop::Eq: return a == b;
+    default: return a != b;
+    }
+}
+
+struct AstNode
+{
+    enum : unsigned { None = ~0u };
+
+    AstKind kind;
+    unsigned char op;
+    unsigned offset;
+    unsigned child;
+    unsigned next;
+};
+
+static_assert(sizeof(AstNode) == 16, "four nodes to a cache line");
+
+// the line, from 1, that a node at offset in text is on, for the errors
+// that fold.hpp and cfg.hpp find in the tree
+CONSTEXPR int line_of(char const* const text, unsigned const offset)
+{
+    int line = 1;
+    for(unsigned i = 0; i != offset; ++i) line += text[i] == '\n';
+    return line;
+}
+
+// Where the parser puts the nodes: storage that belongs to the caller,
+// filled from the front. Running out of it does not stop the parse, the
+// nodes that did not fit are dropped and overflow() says so; a source of
+// n characters never needs more than n + 1 nodes.
+struct AstArena
+{
+    AstNode* nodes_;
+    unsigned capacity_;
+    unsigned size_;
+    // the root of what the parser read last
+    unsigned last_;
+    unsigned first_;
+    unsigned tail_;
+    bool overflow_;
+
+    CONSTEXPR AstArena(AstNode* nodes, unsigned capacity)
+        : nodes_(nodes)
+          , capacity_(capacity)
+          , size_(0)
+          , last_(AstNode::None)
+          , first_(AstNode::None)
+          , tail_(AstNode::None)
+          , overflow_(false)
+    {}
+
+    CONSTEXPR unsigned size() const { return size_; }
+    CONSTEXPR unsigned last() const { return last_; }
+    // the first line, if any
+    CONSTEXPR unsigned first() const { return first_; }
+    CONSTEXPR bool overflow() const { return overflow_; }
+    CONSTEXPR AstNode const& operator[](unsigned i) const { return nodes_[i]; }
+
+    CONSTEXPR unsigned push(AstKind kind, unsigned char op, unsigned offset, unsigned child)
+    {
+        if(size_ == capacity_) {
+            overflow_ = true;
+            return last_ = AstNode::None;
+        }
+        nodes_[size_] = AstNode{kind, op, offset, child, AstNode::None};
+        return last_ = size_++;
+    }
+
+    // a line, after the one before it
+    CONSTEXPR void line(unsigned char op, unsigned offset, unsigned child)
+    {
+        unsigned const l = push(AstKind::Line, op, offset, child);
+        if(l == AstNode::None) return;
+        if(tail_ == AstNode::None) first_ = l;
+        else nodes_[tail_].next = l;
+        tail_ = l;
+    }
+
+    CONSTEXPR void link(unsigned node, unsigned next)
+    {
+        if(node < size_) nodes_[node].next = next;
+    }
+
+    CONSTEXPR void adopt(unsigned node, unsigned child)
+    {
+        if(node < size_) nodes_[node].child = child;
+    }
+
+    // drops what an alternative that failed has added
+    CONSTEXPR void truncate(unsigned size)
+    {
+        if(size < size_) size_ = size;
+    }
+};
+
+// the arena of a program parsed at compile time, see ast<N>() in
+// parser.hpp
+template<unsigned N>
+struct Ast
+{
+    AstNode nodes[N];
+    unsigned size;
+    unsigned first;
+    bool overflow;
+    unsigned long long result;
+
+    CONSTEXPR AstNode const& operator[](unsigned i) const { return nodes[i]; }
+};
+
+} // namespace Jak
+
+#endif
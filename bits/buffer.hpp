@@ -30,7 +30,7 @@ namespace Jak {
 
 struct Buf
 {
-    char const* const s_;
+    char const* s_;
     unsigned len_;
 
     template<unsigned N>
@@ -41,16 +41,6 @@ struct Buf
         static_assert(N >= 1, "not a string literal");
     }
 
-    constexpr Buf(Buf&& b)
-        : s_(b.s_)
-          , len_(b.len_)
-    {}
-
-    constexpr Buf(Buf const& b)
-        : s_(b.s_)
-          , len_(b.len_)
-    {}
-
     constexpr Buf(char const* s, unsigned len)
         : s_(s)
           , len_(len)
@@ -61,6 +51,11 @@ struct Buf
         return {s_ + 1, len_ - 1};
     }
 
+    constexpr Buf tail(unsigned n) const
+    {
+        return {s_ + n, len_ - n};
+    }
+
     constexpr char head() const
     {
         return *s_;
@@ -78,7 +73,7 @@ struct Buf
 
     constexpr bool empty() const
     {
-        return *s_ == '\0';
+        return len_ == 0;
     }
 };
 
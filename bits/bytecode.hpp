@@ -0,0 +1,517 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#ifndef CONSTEXPR
+# define CONSTEXPR constexpr
+#endif
+
+namespace Jak {
+
+// A stack machine. Every instruction is one word, the Op in the low 8
+// bits and its argument in the other 24; sources are shorter than 2^23
+// characters, so addresses and indices always fit.
+enum class Op : unsigned char {
+    Push,           // pushes arg, for literals below 2^24
+    Constant,       // pushes numbers[arg]
+    Load,           // pushes variable arg, 0 for A to 25 for Z
+    Negate,
+    Add,            // these pop the right operand, then the left one
+    Subtract,
+    Multiply,
+    Divide,
+    Compare,        // arg: the AstRelop; pushes 1 if it holds, else 0
+    JumpUnless,     // pops, and goes to address arg if that is 0
+    Store,          // pops into variable arg
+    Input,          // reads a number into variable arg
+    PrintString,    // strings[arg]
+    PrintValue,     // pops
+    PrintLine,      // ends a PRINT
+    Data,           // pops, onto the DATA values
+    Goto,           // pops a line number
+    Gosub,          // the same, coming back after it on RETURN
+    Jump,           // goes to address arg, for a GOTO to a constant
+    Call,           // the same for a GOSUB
+    Missing,        // a GOTO or GOSUB to a constant that is no line
+    Return,
+    Clear,
+    List,
+    Run,
+    End
+};
+
+CONSTEXPR unsigned instruction(Op op, unsigned arg)
+{
+    return static_cast<unsigned>(op) | arg << 8;
+}
+
+CONSTEXPR Op op(unsigned instruction)
+{
+    return static_cast<Op>(instruction & 0xFF);
+}
+
+CONSTEXPR unsigned arg(unsigned instruction)
+{
+    return instruction >> 8;
+}
+
+// The sections of a compiled program, in the order they are laid out in
+// after a header of their sizes: the code, the numbers too large to
+// push directly, the strings as an offset into the source and a length,
+// the numbered lines as their number and the address of their code, and
+// an index of those lines. The header also has the most the code ever
+// has on its stack.
+//
+// When the line numbers are dense enough, the index is a table of the
+// addresses of lines first to first + dense - 1, with NoLine for the
+// numbers in between; a jump then takes one subtraction, one compare and
+// one load. Otherwise it holds the sorted line number and address
+// pairs, to search. Either way, the first of two lines with the same
+// number is the one jumped to.
+//
+// Lines that cfg.hpp marked as unreachable have no code and no place in
+// the index. The header counts them, and the numbered ones are still
+// among the lines, with NoLine for their address.
+struct BytecodeSizes
+{
+    enum : unsigned
+    {
+        Header = 9,
+        NoLine = ~0u,
+        // how many entries per line a dense index may take, at most
+        Sparseness = 16
+    };
+
+    unsigned code;
+    unsigned numbers;
+    unsigned strings;
+    unsigned lines;
+    unsigned stack;
+    unsigned first;
+    unsigned dense;
+    unsigned sorted;
+    unsigned removed;
+
+    CONSTEXPR unsigned words() const
+    {
+        return Header + code + numbers + 2 * strings + 2 * lines + dense + 2 * sorted;
+    }
+};
+
+// a whole program, fit for .rodata
+template<unsigned N>
+struct Bytecode
+{
+    unsigned words[N];
+};
+
+// a compiled program with the source it came from, whatever its size
+struct BytecodeView
+{
+    unsigned const* words_;
+    char const* source_;
+
+    CONSTEXPR unsigned size() const { return words_[0]; }
+    CONSTEXPR unsigned const* code() const { return words_ + BytecodeSizes::Header; }
+    CONSTEXPR unsigned const* numbers() const { return code() + words_[0]; }
+    CONSTEXPR unsigned number_count() const { return words_[1]; }
+    // offset and length pairs into source()
+    CONSTEXPR unsigned const* strings() const { return numbers() + words_[1]; }
+    CONSTEXPR unsigned string_count() const { return words_[2]; }
+    // line number and address pairs, in the order of the source
+    CONSTEXPR unsigned const* lines() const { return strings() + 2 * words_[2]; }
+    CONSTEXPR unsigned line_count() const { return words_[3]; }
+    CONSTEXPR unsigned stack() const { return words_[4]; }
+    // the line index, see BytecodeSizes
+    CONSTEXPR unsigned const* index() const { return lines() + 2 * words_[3]; }
+    CONSTEXPR Value first_line() const { return static_cast<Value>(words_[5]); }
+    CONSTEXPR unsigned dense() const { return words_[6]; }
+    CONSTEXPR unsigned sorted() const { return words_[7]; }
+    // how many lines were left out as unreachable, see cfg.hpp
+    CONSTEXPR unsigned removed() const { return words_[8]; }
+
+    // the address of line number l, or NoLine
+    CONSTEXPR unsigned address(Value const l) const
+    {
+        unsigned const k = static_cast<unsigned>(l) - words_[5];
+        if(k < words_[6]) return index()[k];
+        unsigned lo = 0;
+        unsigned hi = words_[7];
+        while(lo != hi) {
+            unsigned const mid = lo + (hi - lo) / 2;
+            if(static_cast<Value>(index()[2 * mid]) < l) lo = mid + 1;
+            else hi = mid;
+        }
+        if(lo != words_[7] && static_cast<Value>(index()[2 * lo]) == l) return index()[2 * lo + 1];
+        return BytecodeSizes::NoLine;
+    }
+    CONSTEXPR char const* source() const { return source_; }
+};
+
+// Compiles the flat AST of a program that parsed, lines in order, into
+// words_; with words_ null it only counts, which is how the size of the
+// Bytecode gets known. Code falls through from a line to the next, and
+// past the last one to an End. Trees folded by fold.hpp compile to less
+// code: constants are pushed as one, and IFs with a constant condition
+// run their statement or nothing. A GOTO or GOSUB to a constant is emitted
+// with the node of its target, and once the index is done, rewritten to
+// go straight to the address of that line.
+template<unsigned N>
+struct BytecodeCompiler
+{
+    Ast<N> const& tree_;
+    char const* text_;
+    unsigned* words_;
+    // where each section starts, then how much has gone into it
+    BytecodeSizes base_;
+    BytecodeSizes size_;
+    unsigned depth_;
+    Value low_;
+    Value high_;
+    // the numbered lines that have code
+    unsigned indexed_;
+
+    CONSTEXPR void emit(Op o, unsigned a)
+    {
+        if(words_) words_[base_.code + size_.code] = instruction(o, a);
+        ++size_.code;
+        switch(o)
+        {
+        case Op::Push:
+        case Op::Constant:
+        case Op::Load:
+            if(++depth_ > size_.stack) size_.stack = depth_;
+            break;
+        case Op::Add:
+        case Op::Subtract:
+        case Op::Multiply:
+        case Op::Divide:
+        case Op::Compare:
+        case Op::JumpUnless:
+        case Op::Store:
+        case Op::PrintValue:
+        case Op::Data:
+        case Op::Goto:
+        case Op::Gosub:
+            --depth_;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // the value of a Number or a Constant
+    CONSTEXPR Value literal(AstNode const& n) const
+    {
+        return n.kind == AstKind::Constant ? static_cast<Value>(n.child) : value(text_ + n.offset, n.child);
+    }
+
+    CONSTEXPR void number(Value const v)
+    {
+        if(static_cast<unsigned>(v) < (1u << 24)) {
+            emit(Op::Push, static_cast<unsigned>(v));
+            return;
+        }
+        if(words_) words_[base_.numbers + size_.numbers] = static_cast<unsigned>(v);
+        emit(Op::Constant, size_.numbers++);
+    }
+
+    CONSTEXPR void expression(unsigned i)
+    {
+        AstNode const& n = tree_[i];
+        switch(n.kind)
+        {
+        case AstKind::Number:
+        case AstKind::Constant:
+            number(literal(n));
+            break;
+        case AstKind::Var:
+            emit(Op::Load, static_cast<unsigned>(text_[n.offset] - 'A'));
+            break;
+        case AstKind::Negate:
+            expression(n.child);
+            emit(Op::Negate, 0);
+            break;
+        case AstKind::Binary:
+            expression(n.child);
+            expression(tree_[n.child].next);
+            emit(n.op == '+' ? Op::Add : n.op == '-' ? Op::Subtract : n.op == '*' ? Op::Multiply : Op::Divide, 0);
+            break;
+        default:
+            break;
+        }
+    }
+
+    CONSTEXPR void statement(unsigned i)
+    {
+        AstNode const& n = tree_[i];
+        switch(static_cast<Keyword>(n.op))
+        {
+        case Keyword::PRINT:
+            for(unsigned item = tree_[n.child].child; item != AstNode::None; item = tree_[item].next) {
+                if(tree_[item].kind == AstKind::String) {
+                    if(words_) {
+                        words_[base_.strings + 2 * size_.strings] = tree_[item].offset;
+                        words_[base_.strings + 2 * size_.strings + 1] = tree_[item].child;
+                    }
+                    emit(Op::PrintString, size_.strings++);
+                } else {
+                    expression(item);
+                    emit(Op::PrintValue, 0);
+                }
+            }
+            emit(Op::PrintLine, 0);
+            break;
+        case Keyword::DATA:
+            for(unsigned item = tree_[n.child].child; item != AstNode::None; item = tree_[item].next) {
+                // strings are only good for PRINT
+                if(tree_[item].kind == AstKind::String) continue;
+                expression(item);
+                emit(Op::Data, 0);
+            }
+            break;
+        case Keyword::IF:
+            {
+                AstNode const& relop = tree_[n.child];
+                // a folded condition leaves the statement or nothing
+                if(relop.kind == AstKind::Constant) {
+                    if(relop.child != 0) statement(relop.next);
+                    break;
+                }
+                expression(relop.child);
+                expression(tree_[relop.child].next);
+                emit(Op::Compare, relop.op);
+                unsigned const jump = size_.code;
+                emit(Op::JumpUnless, 0);
+                statement(relop.next);
+                if(words_) words_[base_.code + jump] = instruction(Op::JumpUnless, size_.code);
+            }
+            break;
+        case Keyword::GOTO:
+            if(tree_[n.child].kind == AstKind::Number || tree_[n.child].kind == AstKind::Constant) {
+                emit(Op::Jump, n.child);
+                break;
+            }
+            expression(n.child);
+            emit(Op::Goto, 0);
+            break;
+        case Keyword::GOSUB:
+            if(tree_[n.child].kind == AstKind::Number || tree_[n.child].kind == AstKind::Constant) {
+                emit(Op::Call, n.child);
+                break;
+            }
+            expression(n.child);
+            emit(Op::Gosub, 0);
+            break;
+        case Keyword::INPUT:
+            for(unsigned v = tree_[n.child].child; v != AstNode::None; v = tree_[v].next) {
+                emit(Op::Input, static_cast<unsigned>(text_[tree_[v].offset] - 'A'));
+            }
+            break;
+        case Keyword::LET:
+            expression(tree_[n.child].next);
+            emit(Op::Store, static_cast<unsigned>(text_[tree_[n.child].offset] - 'A'));
+            break;
+        case Keyword::RETURN: emit(Op::Return, 0); break;
+        case Keyword::CLEAR: emit(Op::Clear, 0); break;
+        case Keyword::LIST: emit(Op::List, 0); break;
+        case Keyword::RUN: emit(Op::Run, 0); break;
+        default: emit(Op::End, 0); break;
+        }
+    }
+
+    CONSTEXPR void program()
+    {
+        if(UnpackCode(tree_.result) != Code::Okay || tree_.overflow) return;
+        for(unsigned l = tree_.first; l != AstNode::None; l = tree_[l].next) {
+            AstNode const& line = tree_[l];
+            bool const removed = line.op & 2;
+            size_.removed += removed;
+            unsigned statement_node = line.child;
+            if(line.op & 1) {
+                AstNode const& label = tree_[line.child];
+                Value const number = value(text_ + label.offset, label.child);
+                if(words_) {
+                    words_[base_.lines + 2 * size_.lines] = static_cast<unsigned>(number);
+                    words_[base_.lines + 2 * size_.lines + 1] = removed ? BytecodeSizes::NoLine : size_.code;
+                }
+                ++size_.lines;
+                statement_node = label.next;
+                if(!removed) {
+                    if(indexed_ == 0 || number < low_) low_ = number;
+                    if(indexed_ == 0 || number > high_) high_ = number;
+                    ++indexed_;
+                }
+            }
+            if(!removed) statement(statement_node);
+        }
+        emit(Op::End, 0);
+
+        if(indexed_ != 0) {
+            unsigned long long const span = static_cast<unsigned long long>(
+                    static_cast<long long>(high_) - static_cast<long long>(low_)) + 1;
+            size_.first = static_cast<unsigned>(low_);
+            if(span <= static_cast<unsigned long long>(BytecodeSizes::Sparseness) * indexed_) {
+                size_.dense = static_cast<unsigned>(span);
+            } else {
+                size_.sorted = indexed_;
+            }
+        }
+        if(words_) {
+            index();
+            resolve();
+        }
+    }
+
+    CONSTEXPR void index()
+    {
+        unsigned const* const lines = words_ + base_.lines;
+        unsigned* const index = words_ + base_.lines + 2 * size_.lines;
+        for(unsigned i = 0; i != size_.dense; ++i) index[i] = BytecodeSizes::NoLine;
+        for(unsigned i = 0; size_.dense != 0 && i != size_.lines; ++i) {
+            if(lines[2 * i + 1] == BytecodeSizes::NoLine) continue;
+            unsigned const k = lines[2 * i] - size_.first;
+            if(index[k] == BytecodeSizes::NoLine) index[k] = lines[2 * i + 1];
+        }
+        // an insertion sort, stable and linear on lines that are in order
+        // already, as they mostly are
+        for(unsigned i = 0, n = 0; size_.sorted != 0 && i != size_.lines; ++i) {
+            if(lines[2 * i + 1] == BytecodeSizes::NoLine) continue;
+            unsigned j = n++;
+            while(j != 0 && static_cast<Value>(index[2 * (j - 1)]) > static_cast<Value>(lines[2 * i])) {
+                index[2 * j] = index[2 * (j - 1)];
+                index[2 * j + 1] = index[2 * (j - 1) + 1];
+                --j;
+            }
+            index[2 * j] = lines[2 * i];
+            index[2 * j + 1] = lines[2 * i + 1];
+        }
+    }
+
+    CONSTEXPR void resolve()
+    {
+        BytecodeView const view {words_, text_};
+        unsigned* const code = words_ + base_.code;
+        for(unsigned i = 0; i != size_.code; ++i) {
+            Op const o = op(code[i]);
+            if(o != Op::Jump && o != Op::Call) continue;
+            unsigned const address = view.address(literal(tree_[arg(code[i])]));
+            code[i] = address == BytecodeSizes::NoLine
+                ? instruction(Op::Missing, 0)
+                : instruction(o, address);
+        }
+        // jumps to a Jump go where it does, e.g. an IF that skips to a
+        // line that is a GOTO
+        for(unsigned i = 0; i != size_.code; ++i) {
+            Op const o = op(code[i]);
+            if(o != Op::Jump && o != Op::Call && o != Op::JumpUnless) continue;
+            unsigned to = arg(code[i]);
+            for(unsigned n = 0; n != size_.code && op(code[to]) == Op::Jump; ++n) to = arg(code[to]);
+            code[i] = instruction(o, to);
+        }
+    }
+};
+
+template<unsigned N>
+CONSTEXPR BytecodeSizes bytecode_sizes(Ast<N> const& tree, Buf const buf)
+{
+    BytecodeCompiler<N> c {tree, buf.text(), nullptr, {}, {}, 0, 0, 0, 0};
+    c.program();
+    return c.size_;
+}
+
+// the number of words the Bytecode of a program takes
+template<unsigned N>
+CONSTEXPR unsigned bytecode_words(Ast<N> const& tree, Buf const buf)
+{
+    return bytecode_sizes(tree, buf).words();
+}
+
+// writes the Bytecode of tree, which takes sizes, into words
+template<unsigned N>
+CONSTEXPR void compile(unsigned* words, Ast<N> const& tree, Buf const buf, BytecodeSizes const sizes)
+{
+    BytecodeCompiler<N> c {tree, buf.text(), words, {}, {}, 0, 0, 0, 0};
+    c.base_.code = BytecodeSizes::Header;
+    c.base_.numbers = c.base_.code + sizes.code;
+    c.base_.strings = c.base_.numbers + sizes.numbers;
+    c.base_.lines = c.base_.strings + 2 * sizes.strings;
+    words[0] = sizes.code;
+    words[1] = sizes.numbers;
+    words[2] = sizes.strings;
+    words[3] = sizes.lines;
+    words[4] = sizes.stack;
+    words[5] = sizes.first;
+    words[6] = sizes.dense;
+    words[7] = sizes.sorted;
+    words[8] = sizes.removed;
+    c.program();
+}
+
+template<unsigned W, unsigned N>
+CONSTEXPR Bytecode<W> compile(Ast<N> const& tree, Buf const buf)
+{
+    Bytecode<W> ret {};
+    compile(ret.words, tree, buf, bytecode_sizes(tree, buf));
+    return ret;
+}
+
+// What compiling a program from its source takes, worked out in a
+// constant expression of its own: whether it is valid, and the sizes of
+// the sections of its Bytecode, which compile() below then fills in
+// without working them out again. A Bytecode as large as any program
+// could need, copied out of such a constant, would have that constant
+// built on the stack at -O0 instead.
+struct BytecodePlan
+{
+    unsigned long long result;
+    unsigned words;
+    BytecodeSizes sizes;
+};
+
+// The tree of a program only lives as long as one of these calls, so a
+// constant made from them holds no more than what it returns. N and L are
+// as for optimized().
+template<unsigned N, unsigned L>
+CONSTEXPR BytecodePlan bytecode_plan(Buf const buf)
+{
+    Ast<N> const tree = optimized<N, L>(buf);
+    BytecodeSizes const sizes = bytecode_sizes(tree, buf);
+    return { tree.result, sizes.words(), sizes };
+}
+
+template<unsigned W, unsigned N, unsigned L>
+CONSTEXPR Bytecode<W> compile(Buf const buf, BytecodeSizes const sizes)
+{
+    Bytecode<W> ret {};
+    compile(ret.words, optimized<N, L>(buf), buf, sizes);
+    return ret;
+}
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,236 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef CFG_HPP
+#define CFG_HPP
+
+#ifndef CONSTEXPR
+# define CONSTEXPR constexpr
+#endif
+
+namespace Jak {
+
+// The control flow of a program between its lines, on a tree folded by
+// fold.hpp, which it changes in place. A GOTO or GOSUB to a constant
+// goes to the end of any chain of lines that only GOTO a constant, and
+// the lines that no path from the first one reaches any more get 2 added
+// to their op, for the compiler to leave out. A line is reached from the
+// one before it unless that one ends, returns or jumps away; RETURN goes
+// back to the line after a GOSUB, so that line counts as reached from
+// the GOSUB. A GOTO or GOSUB that is computed may go to any numbered
+// line, and once one is reached, all of them are. Every array has room
+// for the L lines a program may have, see line_bound().
+template<unsigned L>
+struct Cfg
+{
+    enum : unsigned { None = AstNode::None };
+
+    AstNode* nodes_;
+    char const* text_;
+    // the line nodes in order, and the statement each one runs
+    unsigned lines_[L];
+    unsigned statements_[L];
+    // lines_ indices of the numbered lines, sorted by their number
+    unsigned sorted_[L];
+    Value labels_[L];
+    bool reached_[L];
+    unsigned work_[L];
+    unsigned n_;
+    unsigned numbered_;
+    unsigned pending_;
+    bool anywhere_;
+
+    // the statement an IF with a constant condition comes down to: the
+    // one after THEN, or None for nothing
+    CONSTEXPR unsigned effective(unsigned s) const
+    {
+        while(s != None && static_cast<Keyword>(nodes_[s].op) == Keyword::IF
+                && nodes_[nodes_[s].child].kind == AstKind::Constant) {
+            s = nodes_[nodes_[s].child].child != 0 ? nodes_[nodes_[s].child].next : None;
+        }
+        return s;
+    }
+
+    // the first line numbered v, or None
+    CONSTEXPR unsigned find(Value const v) const
+    {
+        unsigned lo = 0, hi = numbered_;
+        while(lo != hi) {
+            unsigned const mid = lo + (hi - lo) / 2;
+            if(labels_[sorted_[mid]] < v) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo != numbered_ && labels_[sorted_[lo]] == v ? sorted_[lo] : None;
+    }
+
+    // whether s is a GOTO or a GOSUB to a constant
+    CONSTEXPR bool constant_jump(unsigned const s, Keyword const k) const
+    {
+        return s != None && static_cast<Keyword>(nodes_[s].op) == k
+            && nodes_[nodes_[s].child].kind == AstKind::Constant;
+    }
+
+    // where a jump to v ends up, at most n_ lines further on, which also
+    // stops at a loop of GOTOs
+    CONSTEXPR Value thread(Value v) const
+    {
+        for(unsigned i = 0; i != n_; ++i) {
+            unsigned const k = find(v);
+            if(k == None || !constant_jump(statements_[k], Keyword::GOTO)) break;
+            v = static_cast<Value>(nodes_[nodes_[statements_[k]].child].child);
+        }
+        return v;
+    }
+
+    CONSTEXPR void reach(unsigned const k)
+    {
+        if(k == None || k >= n_ || reached_[k]) return;
+        reached_[k] = true;
+        work_[pending_++] = k;
+    }
+
+    CONSTEXPR void jump(unsigned const s)
+    {
+        AstNode& target = nodes_[nodes_[s].child];
+        if(target.kind != AstKind::Constant) {
+            if(anywhere_) return;
+            anywhere_ = true;
+            for(unsigned i = 0; i != numbered_; ++i) reach(sorted_[i]);
+            return;
+        }
+        target.child = static_cast<unsigned>(thread(static_cast<Value>(target.child)));
+        reach(find(static_cast<Value>(target.child)));
+    }
+
+    // the lines statement s of line k goes on to
+    CONSTEXPR void successors(unsigned const k, unsigned s)
+    {
+        s = effective(s);
+        if(s == None) {
+            reach(k + 1);
+            return;
+        }
+        switch(static_cast<Keyword>(nodes_[s].op))
+        {
+        case Keyword::IF:
+            reach(k + 1);
+            successors(k, nodes_[nodes_[s].child].next);
+            break;
+        case Keyword::GOTO:
+            jump(s);
+            break;
+        case Keyword::GOSUB:
+            jump(s);
+            reach(k + 1);
+            break;
+        case Keyword::END:
+        case Keyword::RETURN:
+            break;
+        case Keyword::RUN:
+            reach(0);
+            break;
+        default:
+            reach(k + 1);
+            break;
+        }
+    }
+
+    // UndefinedLine for the first GOTO or GOSUB to a constant that no
+    // line has, which check_jumps() only sees when it is a literal
+    CONSTEXPR unsigned long long undefined(unsigned long long const result) const
+    {
+        for(unsigned k = 0; k != n_; ++k) {
+            unsigned s = statements_[k];
+            while(s != None && static_cast<Keyword>(nodes_[s].op) == Keyword::IF) s = nodes_[nodes_[s].child].next;
+            if((constant_jump(s, Keyword::GOTO) || constant_jump(s, Keyword::GOSUB))
+                    && find(static_cast<Value>(nodes_[nodes_[s].child].child)) == None)
+                return PackResult(Code::UndefinedLine, line_of(text_, nodes_[s].offset));
+        }
+        return result;
+    }
+
+    // returns result, or what undefined() found
+    CONSTEXPR unsigned long long program(unsigned const first, unsigned long long const result)
+    {
+        n_ = 0;
+        numbered_ = 0;
+        for(unsigned l = first; l != None; l = nodes_[l].next) {
+            if(n_ == L) return result;
+            AstNode const& line = nodes_[l];
+            lines_[n_] = l;
+            statements_[n_] = line.op ? nodes_[line.child].next : line.child;
+            reached_[n_] = false;
+            if(line.op) {
+                AstNode const& label = nodes_[line.child];
+                labels_[n_] = value(text_ + label.offset, label.child);
+                // an insertion sort, stable, so that the first of two
+                // lines with the same number is found, as in the VM
+                unsigned i = numbered_++;
+                for(; i != 0 && labels_[sorted_[i - 1]] > labels_[n_]; --i) sorted_[i] = sorted_[i - 1];
+                sorted_[i] = n_;
+            }
+            ++n_;
+        }
+        unsigned long long const checked = undefined(result);
+        if(checked != result) return checked;
+        pending_ = 0;
+        anywhere_ = false;
+        reach(0);
+        while(pending_ != 0) {
+            unsigned const k = work_[--pending_];
+            successors(k, statements_[k]);
+        }
+        for(unsigned k = 0; k != n_; ++k) {
+            if(!reached_[k]) nodes_[lines_[k]].op |= 2;
+        }
+        return result;
+    }
+};
+
+// the Ast of a program, folded, its jumps threaded and its unreachable
+// lines marked, for constant expressions; L is how many lines it may
+// have, see line_bound(). Once the whole program has parsed, its result
+// is the error on the lowest line among a DivisionByZero, a jump to a
+// constant that only folding made one, and a jump to a literal, which
+// folding may have dropped with its IF.
+template<unsigned N, unsigned L>
+CONSTEXPR Ast<N> optimized(Buf const buf)
+{
+    Value labels[L] {};
+    JumpTarget targets[L] {};
+    Jumps jumps(labels, targets, L);
+    Ast<N> ret = folded<N>(buf, &jumps);
+    Code const code = UnpackCode(ret.result);
+    if((code != Code::Okay && code != Code::DivisionByZero) || ret.overflow) return ret;
+    unsigned long long const okay = PackResult(Code::Okay, UnpackLine(ret.result));
+    Cfg<L> cfg {ret.nodes, buf.text(), {}, {}, {}, {}, {}, {}, 0, 0, 0, false};
+    ret.result = FirstError(ret.result,
+            FirstError(cfg.program(ret.first, okay), check_jumps(okay, jumps)));
+    return ret;
+}
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,173 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef FOLD_HPP
+#define FOLD_HPP
+
+#ifndef CONSTEXPR
+# define CONSTEXPR constexpr
+#endif
+
+namespace Jak {
+
+// Folds the constant parts of the flat AST of a program that parsed, in
+// place: every expression with no variable in it, and every IF condition
+// that compares two of them, becomes a Constant node holding its value,
+// 1 or 0 for a condition. Arithmetic wraps around as in vm.hpp. The
+// nodes keep their offset and next, so the tree stays linked as it was.
+// A division by a constant 0 fails with DivisionByZero on its line,
+// whether or not it would ever run.
+struct Folder
+{
+    AstNode* nodes_;
+    char const* text_;
+    unsigned long long result_;
+
+    // whether node i is constant, once it is folded
+    CONSTEXPR bool expression(unsigned const i)
+    {
+        AstNode& n = nodes_[i];
+        switch(n.kind)
+        {
+        case AstKind::Number:
+            return constant(n, value(text_ + n.offset, n.child));
+        case AstKind::Constant:
+            return true;
+        case AstKind::Negate:
+            if(!expression(n.child)) return false;
+            return constant(n, static_cast<Value>(0u - nodes_[n.child].child));
+        case AstKind::Binary:
+        case AstKind::Relop:
+            {
+                // both sides fold, even when one of them is not constant
+                bool const left = expression(n.child);
+                bool const right = expression(nodes_[n.child].next);
+                // dividing anything by a constant 0 is bound to fail
+                if(n.kind == AstKind::Binary && n.op == '/' && right
+                        && nodes_[nodes_[n.child].next].child == 0) {
+                    fail(n);
+                }
+                if(!left || !right) return false;
+                Value const a = static_cast<Value>(nodes_[n.child].child);
+                Value const b = static_cast<Value>(nodes_[nodes_[n.child].next].child);
+                if(n.kind == AstKind::Relop) return constant(n, compare(static_cast<AstRelop>(n.op), a, b));
+                return constant(n, arithmetic(n, a, b));
+            }
+        default:
+            return false;
+        }
+    }
+
+    CONSTEXPR bool constant(AstNode& n, Value const v)
+    {
+        n.kind = AstKind::Constant;
+        n.op = 0;
+        n.child = static_cast<unsigned>(v);
+        return true;
+    }
+
+    static CONSTEXPR Value arithmetic(AstNode const& n, Value const a, Value const b)
+    {
+        unsigned const ua = static_cast<unsigned>(a);
+        unsigned const ub = static_cast<unsigned>(b);
+        switch(n.op)
+        {
+        case '+': return static_cast<Value>(ua + ub);
+        case '-': return static_cast<Value>(ua - ub);
+        case '*': return static_cast<Value>(ua * ub);
+        default:
+            if(b == 0) return 0;
+            // the one quotient that does not fit
+            if(b == -1) return static_cast<Value>(0u - ua);
+            return a / b;
+        }
+    }
+
+    // the first error wins, as the lines are folded in order
+    CONSTEXPR void fail(AstNode const& n)
+    {
+        if(UnpackCode(result_) != Code::Okay) return;
+        result_ = PackResult(Code::DivisionByZero, line_of(text_, n.offset));
+    }
+
+    CONSTEXPR void statement(unsigned const i)
+    {
+        AstNode const& n = nodes_[i];
+        switch(static_cast<Keyword>(n.op))
+        {
+        case Keyword::PRINT:
+        case Keyword::DATA:
+            for(unsigned item = nodes_[n.child].child; item != AstNode::None; item = nodes_[item].next) {
+                expression(item);
+            }
+            break;
+        case Keyword::IF:
+            expression(n.child);
+            statement(nodes_[n.child].next);
+            break;
+        case Keyword::GOTO:
+        case Keyword::GOSUB:
+            expression(n.child);
+            break;
+        case Keyword::LET:
+            expression(nodes_[n.child].next);
+            break;
+        default:
+            break;
+        }
+    }
+
+    CONSTEXPR void program(unsigned const first)
+    {
+        for(unsigned l = first; l != AstNode::None; l = nodes_[l].next) {
+            AstNode const& line = nodes_[l];
+            statement(line.op ? nodes_[line.child].next : line.child);
+        }
+    }
+};
+
+// Folds nodes from the line first on; returns result, or the first
+// DivisionByZero if result was Okay.
+CONSTEXPR unsigned long long fold(AstNode* nodes, unsigned first, unsigned long long result, Buf const buf)
+{
+    if(UnpackCode(result) != Code::Okay) return result;
+    Folder f {nodes, buf.text(), result};
+    f.program(first);
+    return f.result_;
+}
+
+// the Ast of a program, folded, for constant expressions; the jumps, if
+// any, are gathered as it parses
+template<unsigned N>
+CONSTEXPR Ast<N> folded(Buf const buf, Jumps* jumps = nullptr)
+{
+    Ast<N> ret = ast<N>(buf, jumps);
+    if(!ret.overflow) ret.result = fold(ret.nodes, ret.first, ret.result, buf);
+    return ret;
+}
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,493 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef LEXER_HPP
+#define LEXER_HPP
+
+#ifndef CONSTEXPR
+# define CONSTEXPR constexpr
+#endif
+
+// Scanning hooks: each one moves S on and N down over a run of
+// characters, blanks or the body of a string. These plain loops are what constant evaluation uses;
+// scan.hpp replaces them with vectorized ones for the runtime build.
+#ifndef SCAN_BLANKS
+# define SCAN_BLANKS(S, N) do{ while(N != 0 && (*S == ' ' || *S == '\t')) { ++S; --N; } }while(0)
+#endif
+
+// up to either quote, adding the newlines passed over to NEWLINES
+#ifndef SCAN_STRING
+# define SCAN_STRING(S, N, NEWLINES) do{\
+    while(N != 0 && *S != '"' && *S != '\'') { NEWLINES += (*S == '\n'); ++S; --N; }\
+}while(0)
+#endif
+
+namespace Jak {
+
+enum class TokenKind {
+    EndOfFile,
+    Newline,
+    Keyword,
+    Number,
+    Variable,
+    String,
+    Relop,
+    Punct,
+    RunawayString,
+    Invalid
+};
+
+enum class Keyword {
+    PRINT,
+    DATA,
+    IF,
+    GOTO,
+    INPUT,
+    LET,
+    GOSUB,
+    RETURN,
+    CLEAR,
+    LIST,
+    RUN,
+    END,
+    THEN,
+    None
+};
+
+constexpr char const* spelling(Keyword k)
+{
+    switch(k) {
+    case Keyword::PRINT: return "PRINT";
+    case Keyword::DATA: return "DATA";
+    case Keyword::IF: return "IF";
+    case Keyword::GOTO: return "GOTO";
+    case Keyword::INPUT: return "INPUT";
+    case Keyword::LET: return "LET";
+    case Keyword::GOSUB: return "GOSUB";
+    case Keyword::RETURN: return "RETURN";
+    case Keyword::CLEAR: return "CLEAR";
+    case Keyword::LIST: return "LIST";
+    case Keyword::RUN: return "RUN";
+    case Keyword::END: return "END";
+    case Keyword::THEN: return "THEN";
+    default: return "";
+    }
+}
+
+// The keywords above compiled into a trie over 'A'..'Z'. Finding the
+// keyword at the head of a buffer then costs one step per character
+// instead of one attempt per keyword, however many keywords there are.
+struct KeywordTrie
+{
+    struct Node
+    {
+        unsigned char next[26];
+        Keyword keyword;
+    };
+
+    Node nodes[64];
+    unsigned size;
+};
+
+constexpr KeywordTrie BuildKeywordTrie()
+{
+    KeywordTrie trie {};
+    trie.size = 1;
+    trie.nodes[0].keyword = Keyword::None;
+    for(int i = 0; i != static_cast<int>(Keyword::None); ++i) {
+        unsigned n = 0;
+        for(char const* s = spelling(static_cast<Keyword>(i)); *s; ++s) {
+            unsigned char& next = trie.nodes[n].next[*s - 'A'];
+            if(next == 0) {
+                if(trie.size == sizeof(trie.nodes) / sizeof(trie.nodes[0])) {
+                    ++trie.size; // reported by the static_assert below
+                    return trie;
+                }
+                next = static_cast<unsigned char>(trie.size++);
+                trie.nodes[next].keyword = Keyword::None;
+            }
+            n = next;
+        }
+        trie.nodes[n].keyword = static_cast<Keyword>(i);
+    }
+    return trie;
+}
+
+// a template, so that the table can be defined in a header
+template<typename = void>
+struct Keywords
+{
+    static constexpr KeywordTrie trie = BuildKeywordTrie();
+    static_assert(trie.size <= sizeof(trie.nodes) / sizeof(trie.nodes[0]),
+            "too many keywords for KeywordTrie");
+};
+
+template<typename T>
+constexpr KeywordTrie Keywords<T>::trie;
+
+// TinyBasic numbers: 32 bits, wrapping around, literals included
+typedef int Value;
+
+// the value of a number of n digits at s
+CONSTEXPR Value value(char const* s, unsigned n)
+{
+    unsigned v = 0;
+    for(unsigned i = 0; i != n; ++i) v = v * 10 + static_cast<unsigned>(s[i] - '0');
+    return static_cast<Value>(v);
+}
+
+// begin is the first character after the leading blanks, end is one past
+// the token. Tokens that did not match have begin and end pointing at
+// where the mismatch was found.
+struct Token
+{
+    TokenKind kind;
+    Keyword keyword;
+    char const* begin;
+    char const* end;
+    int line;
+    int newlines;
+};
+
+// Scans one token at s_, never reading past the n_ characters that are
+// left: the source does not need to be NUL terminated. Scanning counts
+// down what is left rather than comparing pointers, which costs the
+// constexpr evaluator a lot more memory. The grammar does not reserve its
+// keywords and a letter is a variable wherever an operand is expected, so
+// the parser asks for the kind of token it expects at each point; the
+// tokenize() functions further down track that context themselves.
+struct Lexer
+{
+    char const* s_;
+    unsigned n_;
+    int line_;
+
+    CONSTEXPR Lexer(char const* s, unsigned n, int line)
+        : s_(s)
+          , n_(n)
+          , line_(line)
+    {}
+
+    // moves s past blanks, and n down by as many characters
+    static CONSTEXPR void skip(char const*& s, unsigned& n)
+    {
+        SCAN_BLANKS(s, n);
+    }
+
+    CONSTEXPR char const* skip_blanks() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        return s;
+    }
+
+    CONSTEXPR Token make(TokenKind kind, char const* begin, char const* end) const
+    {
+        return {kind, Keyword::None, begin, end, line_, 0};
+    }
+
+    // blanks are allowed between the letters of a keyword
+    CONSTEXPR Token keyword(Keyword k) const
+    {
+        char const* w = spelling(k);
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        char const* begin = s;
+        while(*w) {
+            while(n != 0 && (*s == ' ' || *s == '\t')) {
+                ++s;
+                --n;
+            }
+            if(n == 0) return make(TokenKind::EndOfFile, s, s);
+            if(*w != *s) return make(TokenKind::Invalid, s, s);
+            ++w;
+            ++s;
+            --n;
+        }
+        return {TokenKind::Keyword, k, begin, s, line_, 0};
+    }
+
+    // whichever keyword is at the head of the buffer, found through the
+    // trie; no keyword is a prefix of another one
+    CONSTEXPR Token keyword() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        char const* begin = s;
+        bool const eof = n == 0;
+        unsigned node = 0;
+        while(true) {
+            while(n != 0 && (*s == ' ' || *s == '\t')) {
+                ++s;
+                --n;
+            }
+            if(n == 0 || *s < 'A' || *s > 'Z') break;
+            node = Keywords<>::trie.nodes[node].next[*s - 'A'];
+            if(node == 0) break;
+            ++s;
+            --n;
+            if(Keywords<>::trie.nodes[node].keyword != Keyword::None) {
+                return {TokenKind::Keyword, Keywords<>::trie.nodes[node].keyword, begin, s, line_, 0};
+            }
+        }
+        return make(eof ? TokenKind::EndOfFile : TokenKind::Invalid, begin, begin);
+    }
+
+    CONSTEXPR Token punct(char c) const
+    {
+        return punct(c, c);
+    }
+
+    // either one of two characters, e.g. the two additive operators
+    CONSTEXPR Token punct(char c1, char c2) const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        if(*s != c1 && *s != c2) return make(TokenKind::Invalid, s, s);
+        return make(TokenKind::Punct, s, s + 1);
+    }
+
+    // one of the four arithmetic operators
+    CONSTEXPR Token arithmetic() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        switch(*s)
+        {
+        case '+':
+        case '-':
+        case '*':
+        case '/':
+            return make(TokenKind::Punct, s, s + 1);
+        default:
+            return make(TokenKind::Invalid, s, s);
+        }
+    }
+
+    // whatever may start an operand: a variable, a number or an opening
+    // parenthesis (as Punct)
+    CONSTEXPR Token operand() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        if(*s >= 'A' && *s <= 'Z') return make(TokenKind::Variable, s, s + 1);
+        if(*s >= '0' && *s <= '9') {
+            char const* e = s + 1;
+            while(--n != 0 && *e >= '0' && *e <= '9') ++e;
+            return make(TokenKind::Number, s, e);
+        }
+        if(*s == '(') return make(TokenKind::Punct, s, s + 1);
+        return make(TokenKind::Invalid, s, s);
+    }
+
+    CONSTEXPR Token number() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        if(*s < '0' || *s > '9') return make(TokenKind::Invalid, s, s);
+        char const* e = s + 1;
+        while(--n != 0 && *e >= '0' && *e <= '9') ++e;
+        return make(TokenKind::Number, s, e);
+    }
+
+    CONSTEXPR Token variable() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        if(*s < 'A' || *s > 'Z') return make(TokenKind::Invalid, s, s);
+        return make(TokenKind::Variable, s, s + 1);
+    }
+
+    CONSTEXPR Token relop() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        switch(*s) {
+        case '<':
+        case '>':
+            if(n == 1) return make(TokenKind::Relop, s, s + 1);
+            switch(s[1]) {
+            case '<':
+            case '>':
+            case '=':
+                return make(TokenKind::Relop, s, s + 2);
+            default:
+                return make(TokenKind::Relop, s, s + 1);
+            }
+        case '=':
+            return make(TokenKind::Relop, s, s + 1);
+        default:
+            return make(TokenKind::Invalid, s, s);
+        }
+    }
+
+    // either quote closes a string, and strings may span several lines
+    CONSTEXPR Token string() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        if(*s != '"' && *s != '\'') return make(TokenKind::Invalid, s, s);
+        char const* e = s + 1;
+        --n;
+        int newlines = 0;
+        SCAN_STRING(e, n, newlines);
+        if(n == 0) {
+            return {TokenKind::RunawayString, Keyword::None, s, e, line_, newlines};
+        }
+        return {TokenKind::String, Keyword::None, s, e + 1, line_, newlines};
+    }
+
+    CONSTEXPR Token newline() const
+    {
+        char const* s = s_;
+        unsigned n = n_;
+        skip(s, n);
+        if(n == 0) return make(TokenKind::EndOfFile, s, s);
+        if(*s != '\n') return make(TokenKind::Invalid, s, s);
+        return make(TokenKind::Newline, s, s + 1);
+    }
+
+    // what is left after t, which this lexer scanned
+    CONSTEXPR Lexer after(Token const& t) const
+    {
+        return Lexer(t.end, n_ - static_cast<unsigned>(t.end - s_),
+                line_ + t.newlines + (t.kind == TokenKind::Newline));
+    }
+};
+
+// Splits a whole program into tokens, for code that wants to walk it more
+// than once. Letters are read as keywords at the start of a statement and
+// after an operand (where only THEN can follow), and as variables
+// everywhere else. Characters that do not start any token become one
+// Invalid token each. Returns the number of tokens written; the last one
+// is always EndOfFile unless the capacity ran out.
+CONSTEXPR unsigned tokenize(Buf const buf, Token* out, unsigned capacity)
+{
+    enum { LineStart, Statement, Operand, Operator } mode = LineStart;
+    Lexer lex(buf.text(), buf.len(), 1);
+    unsigned n = 0;
+    while(n < capacity) {
+        Token t = lex.newline();
+        if(t.kind == TokenKind::EndOfFile) {
+            t = lex.make(TokenKind::EndOfFile, t.end, t.end);
+        } else if(t.kind != TokenKind::Newline) {
+            switch(mode) {
+            case LineStart:
+                t = lex.number();
+                mode = Statement;
+                if(t.kind == TokenKind::Number) break;
+                // fall through
+            case Statement:
+                t = lex.keyword();
+                if(t.kind != TokenKind::Keyword) break;
+                mode = t.keyword == Keyword::RETURN || t.keyword == Keyword::CLEAR
+                    || t.keyword == Keyword::LIST || t.keyword == Keyword::RUN
+                    || t.keyword == Keyword::END
+                    ? Operator
+                    : Operand;
+                break;
+            case Operator:
+                if(lex.skip_blanks() != lex.s_ + lex.n_
+                        && *lex.skip_blanks() >= 'A' && *lex.skip_blanks() <= 'Z') {
+                    t = lex.keyword();
+                    mode = t.keyword == Keyword::THEN ? Statement : Operand;
+                    break;
+                }
+                // fall through
+            case Operand:
+                t = lex.number();
+                if(t.kind != TokenKind::Number) t = lex.variable();
+                if(t.kind != TokenKind::Variable && t.kind != TokenKind::Number) t = lex.string();
+                if(t.kind == TokenKind::Number || t.kind == TokenKind::Variable
+                        || t.kind == TokenKind::String || t.kind == TokenKind::RunawayString) {
+                    mode = Operator;
+                    break;
+                }
+                t = lex.relop();
+                mode = Operand;
+                if(t.kind == TokenKind::Relop) break;
+                switch(*t.begin) {
+                case '+': case '-': case '*': case '/':
+                case '(': case ',':
+                    t = lex.make(TokenKind::Punct, t.begin, t.begin + 1);
+                    break;
+                case ')':
+                    t = lex.make(TokenKind::Punct, t.begin, t.begin + 1);
+                    mode = Operator;
+                    break;
+                }
+                break;
+            }
+        } else {
+            mode = LineStart;
+        }
+        if(t.kind == TokenKind::Invalid) {
+            t.end = t.begin + 1;
+        }
+        out[n++] = t;
+        if(t.kind == TokenKind::EndOfFile) break;
+        lex = lex.after(t);
+    }
+    return n;
+}
+
+// A program has at most one token per character plus the final
+// EndOfFile, so a string literal of N characters (counting the NUL)
+// always fits in N tokens.
+template<unsigned N>
+struct TokenArray
+{
+    Token tokens[N];
+    unsigned size;
+};
+
+template<unsigned N>
+CONSTEXPR TokenArray<N> tokenize(const char(&s)[N])
+{
+    TokenArray<N> ret {};
+    ret.size = tokenize(Buf(s), ret.tokens, N);
+    return ret;
+}
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,183 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+// Validation of large sources on several threads, for the runtime build.
+// Include it after parser.hpp. It uses std::thread, so it needs -pthread
+// where the toolchain asks for it.
+//
+// Lines do not depend on each other: file() only chains line() calls,
+// with the depth cleared in between. So the source is cut at the start of
+// lines into chunks, the chunks are parsed at the same time, and the
+// first one that fails, in order, gives the result.
+//
+// Only strings can hold a newline that does not end a line. Either quote
+// opens a string and either one closes it, so a newline is the end of a
+// line when an even number of quotes comes before it. Cutting the source
+// needs that count, so it takes two passes, both spread over the threads.
+// The first pass looks at evenly sized pieces. Each piece does not know
+// yet whether it starts inside a string, so it notes the first
+// end of line for both cases. It also notes how many quotes and newlines
+// it holds. Adding those up in order says which case applies to each
+// piece, and on which line its chunk starts. The second pass parses the
+// chunks.
+//
+// Quotes only pair up this way up to the first line that fails. That is
+// still enough: chunks after the first failure can be wrong, but their
+// results are never looked at. A runaway string leaves an odd count to
+// the end, so no chunk starts after it and it runs to the real end of the
+// source, as it does for file().
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Jak {
+
+namespace Parallel {
+
+// what the first pass finds out about a piece of the source
+struct Survey
+{
+    bool odd;
+    unsigned newlines;
+    // for a piece that starts outside (0) or inside (1) a string: the
+    // offset just past its first end of line, or none, and the newlines
+    // before that offset
+    unsigned start[2];
+    unsigned before[2];
+};
+
+enum : unsigned { None = ~0u };
+
+inline Survey survey(char const* s, unsigned begin, unsigned end)
+{
+    Survey ret = { false, 0, { None, None }, { 0, 0 } };
+    for(unsigned i = begin; i != end; ++i) {
+        switch(s[i])
+        {
+        case '"':
+        case '\'':
+            ret.odd = !ret.odd;
+            break;
+        case '\n':
+            ++ret.newlines;
+            // outside a string for a piece that started in the state
+            // that the quotes so far have flipped back
+            if(ret.start[ret.odd] == None) {
+                ret.start[ret.odd] = i + 1;
+                ret.before[ret.odd] = ret.newlines;
+            }
+            break;
+        }
+    }
+    return ret;
+}
+
+struct Chunk
+{
+    unsigned begin;
+    unsigned end;
+    int line;
+    unsigned long long result;
+};
+
+// Runs work(i) for every i below n on threads threads, handing out the
+// next i to whichever thread is free.
+template<typename Work>
+void run(unsigned n, unsigned threads, Work const& work)
+{
+    std::atomic<unsigned> next(0);
+    auto worker = [&]() {
+        for(unsigned i; (i = next.fetch_add(1)) < n;) work(i);
+    };
+    std::vector<std::thread> pool;
+    for(unsigned t = 1; t < threads && t < n; ++t) pool.emplace_back(worker);
+    worker();
+    for(auto& t : pool) t.join();
+}
+
+// pieces smaller than this are not worth a thread
+enum : unsigned { MinPiece = 64 * 1024 };
+
+} // namespace Parallel
+
+// The same as TinyBasicParser(buf).file().result(), using up to threads
+// threads, or as many as the hardware has for 0.
+inline unsigned long long validate(Buf const buf, unsigned threads = 0)
+{
+    using namespace Parallel;
+
+    if(threads == 0) threads = std::thread::hardware_concurrency();
+    if(threads == 0) threads = 1;
+    unsigned const len = buf.len();
+    unsigned pieces = threads * 4;
+    if(pieces > len / MinPiece) pieces = len / MinPiece;
+    if(pieces <= 1 || len > TinyBasicParser::MaxSourceLength) {
+        return TinyBasicParser(buf).file().result();
+    }
+
+    char const* const s = buf.text();
+    std::vector<Survey> surveys(pieces);
+    run(pieces, threads, [&](unsigned i) {
+            surveys[i] = survey(s, static_cast<unsigned long long>(len) * i / pieces,
+                    static_cast<unsigned long long>(len) * (i + 1) / pieces);
+            });
+
+    std::vector<Chunk> chunks;
+    chunks.push_back({ 0, len, 1, 0 });
+    bool odd = false;
+    unsigned newlines = 0;
+    for(unsigned i = 0; i != pieces; ++i) {
+        Survey const& v = surveys[i];
+        if(i != 0 && v.start[odd] != None) {
+            chunks.back().end = v.start[odd];
+            chunks.push_back({ v.start[odd], len, static_cast<int>(1 + newlines + v.before[odd]), 0 });
+        }
+        odd = odd != v.odd;
+        newlines += v.newlines;
+    }
+
+    // chunks after one that failed do not matter any more
+    std::atomic<unsigned> failed(static_cast<unsigned>(chunks.size()));
+    run(static_cast<unsigned>(chunks.size()), threads, [&](unsigned i) {
+            if(i > failed.load()) return;
+            Chunk& c = chunks[i];
+            c.result = TinyBasicParser(Buf(s + c.begin, c.end - c.begin), c.line).file().result();
+            if(UnpackCode(c.result) != Code::Okay) {
+                unsigned f = failed.load();
+                while(i < f && !failed.compare_exchange_weak(f, i)) {}
+            }
+            });
+
+    unsigned const f = failed.load();
+    return chunks[f < chunks.size() ? f : chunks.size() - 1].result;
+}
+
+} // namespace Jak
+
+#endif
@@ -38,55 +38,254 @@
 # define DTRACE(F, ...)
 #endif
 
+// sees the Buf of every parser made from one, see trace.hpp
+#ifndef TRACE_SOURCE
+# define TRACE_SOURCE(B)
+#endif
+
+// Counting what each rule costs, see profile.hpp; the counters live
+// outside of the parser state, which only carries a pointer to them.
+// PROFILE_RULE starts every rule. To see what the rule returns, it calls
+// the rule again (CALL) and books the result, after Profile::wrap() has
+// told the inner call to go ahead with the body instead.
+#ifdef JAK_PROFILE
+# define PROFILE_ENTER(RULE) do{ if(profile_) profile_->enter(RULE); }while(0)
+# define PROFILE_RESUME(RULE) do{ if(profile_) profile_->resume(RULE); }while(0)
+# define PROFILE_CONSUME(N) do{ if(profile_) profile_->consume(N); }while(0)
+# define PROFILE_RULE(RULE, CALL) do{\
+    if(profile_ && profile_->wrap(RULE)) {\
+        unsigned long long const profile_nested = profile_->nested();\
+        unsigned long long const profile_start = PROFILE_CLOCK();\
+        TinyBasicParser const profile_ret = CALL;\
+        profile_->leave(RULE, good(), profile_ret.failed(),\
+                static_cast<unsigned>((profile_ret.word_ & OffsetMax) - (word_ & OffsetMax)),\
+                PROFILE_CLOCK() - profile_start, profile_nested);\
+        return profile_ret;\
+    }\
+    PROFILE_ENTER(RULE);\
+}while(0)
+#else
+# define PROFILE_ENTER(RULE)
+# define PROFILE_RESUME(RULE)
+# define PROFILE_CONSUME(N)
+# define PROFILE_RULE(RULE, CALL)
+#endif
+
+// nanoseconds for the time columns of a Profile; the constexpr build has
+// no clock, so they stay at 0 there
+#ifndef PROFILE_CLOCK
+# define PROFILE_CLOCK() 0ull
+#endif
+
+// Building the flat AST of ast.hpp while parsing. As with the profile, the
+// arena lives outside of the state, which only carries a pointer to it.
+// A rule that succeeds leaves the root of what it read in
+// AstArena::last(), where the rule that called it picks it up, with
+// AST_KEEP if it has more to read first. Nodes are only added for states
+// P that are still good, and what a failed alternative of first_of()
+// added goes again.
+#ifdef JAK_AST
+# define AST_LAST() (ast_->last())
+# define AST_KEEP(V) unsigned const V = ast_ ? ast_->last() : AstNode::None
+# define AST_NODE(P, KIND, OP, OFFSET, CHILD) do{\
+    if(ast_ && (P).good()) ast_->push(KIND, static_cast<unsigned char>(OP), OFFSET, CHILD);\
+}while(0)
+# define AST_LINE(P, OP, OFFSET, CHILD) do{ if(ast_ && (P).good()) ast_->line(OP, OFFSET, CHILD); }while(0)
+# define AST_LINK(P, NODE, NEXT) do{ if(ast_ && (P).good()) ast_->link(NODE, NEXT); }while(0)
+# define AST_ADOPT(P, NODE, CHILD) do{ if(ast_ && (P).good()) ast_->adopt(NODE, CHILD); }while(0)
+# define AST_MARK(V) unsigned const V = ast_ ? ast_->size() : 0u
+# define AST_UNDO(V) do{ if(ast_) ast_->truncate(V); }while(0)
+#else
+# define AST_LAST()
+# define AST_KEEP(V)
+# define AST_NODE(P, KIND, OP, OFFSET, CHILD)
+# define AST_LINE(P, OP, OFFSET, CHILD)
+# define AST_LINK(P, NODE, NEXT)
+# define AST_ADOPT(P, NODE, CHILD)
+# define AST_MARK(V)
+# define AST_UNDO(V)
+#endif
+
 namespace Jak {
 
+// A GOTO or GOSUB to a literal line number: a number with at most '+'
+// signs and parentheses around it.
+struct JumpTarget
+{
+    int line;
+    Value target;
+};
+
+// The labels of a program and the literal targets of its GOTO and GOSUB,
+// gathered while it parses, for check_jumps(). As with the AST, the
+// storage belongs to the caller, with room for as many of each as the
+// program has lines, see line_bound(); what does not fit is dropped and
+// overflow() says so. A line only adds to it once it has been read, and
+// a line that fails fails the whole parse, so nothing is ever taken back.
+struct Jumps
+{
+    Value* labels_;
+    JumpTarget* targets_;
+    unsigned capacity_;
+    unsigned labels_size_;
+    unsigned targets_size_;
+    bool overflow_;
+
+    CONSTEXPR Jumps(Value* labels, JumpTarget* targets, unsigned capacity)
+        : labels_(labels)
+          , targets_(targets)
+          , capacity_(capacity)
+          , labels_size_(0)
+          , targets_size_(0)
+          , overflow_(false)
+    {}
+
+    // an insertion sort, cheap for the labels of a program in order
+    CONSTEXPR void label(Value const v)
+    {
+        if(labels_size_ == capacity_) {
+            overflow_ = true;
+            return;
+        }
+        unsigned i = labels_size_++;
+        for(; i != 0 && labels_[i - 1] > v; --i) labels_[i] = labels_[i - 1];
+        labels_[i] = v;
+    }
+
+    CONSTEXPR void target(int const line, Value const v)
+    {
+        if(targets_size_ == capacity_) {
+            overflow_ = true;
+            return;
+        }
+        targets_[targets_size_++] = JumpTarget{line, v};
+    }
+
+    // whether some line has the label v
+    CONSTEXPR bool defined(Value const v) const
+    {
+        unsigned lo = 0, hi = labels_size_;
+        while(lo != hi) {
+            unsigned const mid = lo + (hi - lo) / 2;
+            if(labels_[mid] < v) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo != labels_size_ && labels_[lo] == v;
+    }
+
+    CONSTEXPR bool overflow() const { return overflow_; }
+};
+
+// The rules below use loops instead of recursing once per character, per
+// line or per list element, so the constexpr call depth only grows with
+// the nesting of parentheses and IF ... THEN statements. Characters are
+// only ever looked at through the Lexer.
+//
+// The state is kept small, since the constexpr evaluator holds on to
+// every intermediate one: a pointer to the start of the source, its
+// length, one word packing the offset into it, the line, the depth and
+// the code, and a pointer to where the jumps go. The source is bounded by its length rather than by a
+// NUL, so it may be a mapped file. Depth only ever compares alternatives
+// tried on the same line, so it restarts at every line and saturates
+// instead of overflowing.
 struct TinyBasicParser
 {
-    Code const code_;
-    int const line_;
-    Buf buf_;
-    int const depth_;
+    enum : unsigned
+    {
+        OffsetBits = 23,
+        LineBits = 23,
+        DepthBits = 13,
+        CodeBits = 5,
+
+        LineShift = OffsetBits,
+        DepthShift = LineShift + LineBits,
+        CodeShift = DepthShift + DepthBits,
+
+        OffsetMax = (1u << OffsetBits) - 1,
+        LineMax = (1u << LineBits) - 1,
+        DepthMax = (1u << DepthBits) - 1,
+
+        // so that the line count cannot overflow either, even with a
+        // newline at every character and the final implicit one
+        MaxSourceLength = OffsetMax - 2
+    };
+
+    static_assert(CodeShift + CodeBits == 64, "the state word is 64 bits");
+    static_assert(static_cast<unsigned>(Code::TODO_remove_me) < (1u << CodeBits),
+            "CodeBits too small for Code");
+
+    char const* base_;
+    unsigned len_;
+    unsigned long long word_;
+    // where the labels and literal jumps go, if anywhere
+    Jumps* jumps_;
+#ifdef JAK_PROFILE
+    Profile* profile_;
+#endif
+#ifdef JAK_AST
+    AstArena* ast_;
+#endif
 
     explicit CONSTEXPR TinyBasicParser(Buf const buf)
-        : code_(Code::InternalError)
-          , line_(1)
-          , buf_(buf)
-          , depth_(0)
-    {}
+        : base_(buf.text())
+          , len_(buf.len())
+          , word_(buf.len() <= MaxSourceLength
+                  ? pack(Code::InternalError, 1, 0, 0)
+                  : pack(Code::SourceTooLarge, 1, 0, 0))
+          , jumps_(nullptr)
+#ifdef JAK_PROFILE
+          , profile_(nullptr)
+#endif
+#ifdef JAK_AST
+          , ast_(nullptr)
+#endif
+    {
+        TRACE_SOURCE(buf);
+    }
 
-    CONSTEXPR TinyBasicParser(Code const code, int const line, Buf const buf, int depth)
-        : code_(code)
-          , line_(line)
-          , buf_(buf)
-          , depth_(depth)
-    {}
+    // for the rest of a longer source, cut at the start of its line
+    // number line; parallel.hpp parses a source in such pieces
+    CONSTEXPR TinyBasicParser(Buf const buf, int line)
+        : TinyBasicParser(buf)
+    {
+        word_ += static_cast<unsigned long long>(line - 1) << LineShift;
+    }
 
-    CONSTEXPR TinyBasicParser(TinyBasicParser&& p)
-        : code_(p.code_)
-          , line_(p.line_)
-          , buf_(p.buf_)
-          , depth_(p.depth_)
-    {}
+    CONSTEXPR TinyBasicParser(Buf const buf, Jumps* jumps)
+        : TinyBasicParser(buf)
+    {
+        jumps_ = jumps;
+    }
 
-    CONSTEXPR TinyBasicParser(TinyBasicParser const& p)
-        : code_(p.code_)
-          , line_(p.line_)
-          , buf_(p.buf_)
-          , depth_(p.depth_)
-    {}
+#ifdef JAK_PROFILE
+    CONSTEXPR TinyBasicParser(Buf const buf, Profile* profile, Jumps* jumps = nullptr)
+        : TinyBasicParser(buf, jumps)
+    {
+        profile_ = profile;
+    }
+#endif
 
-    CONSTEXPR Code code() const { return code_; }
-    CONSTEXPR int lineNo() const { return line_; }
-    CONSTEXPR Buf buf() const { return buf_; }
-    CONSTEXPR int depth() const { return depth_; }
+#ifdef JAK_AST
+    CONSTEXPR TinyBasicParser(Buf const buf, AstArena* ast, Jumps* jumps = nullptr)
+        : TinyBasicParser(buf, jumps)
+    {
+        ast_ = ast;
+    }
+#endif
+
+    CONSTEXPR Code code() const { return static_cast<Code>(word_ >> CodeShift); }
+    CONSTEXPR int lineNo() const { return static_cast<int>((word_ >> LineShift) & LineMax); }
+    CONSTEXPR Buf buf() const { return {text(), len_ - static_cast<unsigned>(word_ & OffsetMax)}; }
+    CONSTEXPR int depth() const { return static_cast<int>((word_ >> DepthShift) & DepthMax); }
+    CONSTEXPR unsigned long long result() const { return PackResult(code(), lineNo()); }
 
     CONSTEXPR TinyBasicParser operator||(TinyBasicParser const p) const
     {
         if(failed()) {
-            if(p.failed() && depth_ >= p.depth()) {
+            if(p.failed() && depth() >= p.depth()) {
                 TRACE("||: both " PFMT " and " PFMT " failed, returning " PFMT "\n", P(*this), P(p), P(*this));
                 return *this;
-            } else if(p.failed() && depth_ < p.depth()) {
+            } else if(p.failed() && depth() < p.depth()) {
                 TRACE("||: both " PFMT " and " PFMT " failed, returning " PFMT "\n", P(*this), P(p), P(p));
                 return p;
             }
@@ -98,25 +297,121 @@ struct TinyBasicParser
         return *this;
     }
 
-    CONSTEXPR TinyBasicParser file() const
+    typedef TinyBasicParser (TinyBasicParser::*Rule)() const;
+
+    // Lazy counterpart of operator||: each rule is only applied if all the
+    // ones before it failed. Failures are merged with operator||, so the
+    // alternative that got the furthest (by depth) is still the one
+    // that gets reported.
+    CONSTEXPR TinyBasicParser first_of(Rule r) const
     {
-        if(failed()) {
-            DTRACE("file(): returning immediately\n");
-            return *this;
+        return (this->*r)();
+    }
+
+    template<typename... Rules>
+    CONSTEXPR TinyBasicParser first_of(Rule r, Rules... rs) const
+    {
+        AST_MARK(mark);
+        TinyBasicParser ret = (this->*r)();
+        if(ret.good()) {
+            TRACE("first_of: " PFMT " succeeded, skipping the rest\n", P(ret));
+            return ret;
         }
-        if(buf_.empty()) {
-            DTRACE("file(): empty buffer, returning OK\n");
-            return {Code::Okay, line_, buf_, depth_};
+        AST_UNDO(mark);
+        return ret || first_of(rs...);
+    }
+
+    CONSTEXPR TinyBasicParser file() const
+    {
+        TinyBasicParser p = *this;
+        while(true) {
+            if(p.failed()) {
+                TRACE("file(): " PFMT " failed, returning immediately\n", P(p));
+                return p;
+            }
+            if(p.empty()) {
+                TRACE("file(): " PFMT " empty buffer, returning OK\n", P(p));
+                return p.with(Code::Okay);
+            }
+            TRACE("file(): " PFMT " next line\n", P(p));
+            p = p.line().next_line();
         }
-        DTRACE("file(): recursing\n");
-        return line().file();
     }
 
 private:
 
+    // the same state with another word; copying keeps whatever else the
+    // state carries along
+    CONSTEXPR TinyBasicParser with(unsigned long long const word) const
+    {
+        TinyBasicParser ret = *this;
+        ret.word_ = word;
+        return ret;
+    }
+
+    static CONSTEXPR unsigned long long pack(Code code, unsigned line, unsigned depth, unsigned offset)
+    {
+        return (static_cast<unsigned long long>(code) << CodeShift)
+            | (static_cast<unsigned long long>(depth) << DepthShift)
+            | (static_cast<unsigned long long>(line) << LineShift)
+            | offset;
+    }
+
+    // these run for about every character, so they decode the word
+    // themselves rather than through the accessors above
+    CONSTEXPR char const* text() const
+    {
+        return base_ + (word_ & OffsetMax);
+    }
+
+    CONSTEXPR bool empty() const
+    {
+        return (word_ & OffsetMax) == len_;
+    }
+
+    CONSTEXPR unsigned offset(char const* s) const
+    {
+        return static_cast<unsigned>(s - base_);
+    }
+
+    // moves on by n characters, lines lines and steps steps
+    CONSTEXPR TinyBasicParser advance(unsigned n, unsigned lines, unsigned steps) const
+    {
+        PROFILE_CONSUME(n);
+        unsigned long long const word = word_ + n
+            + (static_cast<unsigned long long>(lines) << LineShift);
+        if(((word_ >> DepthShift) & DepthMax) + steps > DepthMax) {
+            return with(word | (static_cast<unsigned long long>(DepthMax) << DepthShift));
+        }
+        return with(word + (static_cast<unsigned long long>(steps) << DepthShift));
+    }
+
+    // the same, up to s, which is at or after the current position
+    CONSTEXPR TinyBasicParser advance(char const* s, unsigned lines, unsigned steps) const
+    {
+        return advance(static_cast<unsigned>(s - (base_ + (word_ & OffsetMax))), lines, steps);
+    }
+
+    CONSTEXPR TinyBasicParser with(Code c) const
+    {
+        return with((word_ & ~(static_cast<unsigned long long>((1u << CodeBits) - 1) << CodeShift))
+            | (static_cast<unsigned long long>(c) << CodeShift));
+    }
+
+    // fails with c at s, which is at or after the current position
+    CONSTEXPR TinyBasicParser fail(Code c, char const* s) const
+    {
+        return advance(s, 0, 0).with(c);
+    }
+
+    CONSTEXPR TinyBasicParser next_line() const
+    {
+        return with(word_ & ~(static_cast<unsigned long long>(DepthMax) << DepthShift));
+    }
+
     CONSTEXPR bool failed() const
     {
-        switch(code_)
+        switch(static_cast<Code>(word_ >> CodeShift))
         {
         case Code::Okay:
         case Code::InternalError:
@@ -131,263 +426,345 @@ private:
         return !failed();
     }
 
+    CONSTEXPR Lexer lexer() const
+    {
+        return {base_ + (word_ & OffsetMax), len_ - static_cast<unsigned>(word_ & OffsetMax),
+            static_cast<int>((word_ >> LineShift) & LineMax)};
+    }
+
+    CONSTEXPR TinyBasicParser skip_blanks() const
+    {
+        return advance(lexer().skip_blanks(), 0, 0);
+    }
+
+    // turns a token into the next parser state; anything other than the
+    // expected kind of token fails with err
+    CONSTEXPR TinyBasicParser accept(Token const t, TokenKind kind, Code err) const
+    {
+        if(t.kind == kind) {
+            return advance(t.end, t.newlines, 1);
+        }
+        if(t.kind == TokenKind::EndOfFile) {
+            return fail(Code::UnexpectedEndOfFile, t.begin);
+        }
+        return fail(err, t.begin);
+    }
+
+    // Keywords and punctuation. A literal followed by nothing but blanks
+    // fails with UnexpectedEndOfFile, even though it matched.
+    CONSTEXPR TinyBasicParser literal(Token const t) const
+    {
+        switch(t.kind)
+        {
+        case TokenKind::Keyword:
+        case TokenKind::Punct:
+            break;
+        case TokenKind::EndOfFile:
+            return fail(Code::UnexpectedEndOfFile, t.begin);
+        default:
+            return fail(Code::UnknownKeyword, t.begin);
+        }
+        unsigned i = static_cast<unsigned>(t.end - base_);
+        while(i != len_ && (base_[i] == ' ' || base_[i] == '\t')) ++i;
+        if(i == len_) {
+            return fail(Code::UnexpectedEndOfFile, base_ + i);
+        }
+        return advance(t.end, 0, 1);
+    }
+
+    // Books the target of the GOTO or GOSUB on line whose expression runs
+    // from here to end, if it is a literal.
+    CONSTEXPR void jump(int const line, TinyBasicParser const end) const
+    {
+        Lexer x = lexer();
+        unsigned open = 0;
+        while(true) {
+            if(x.punct('+').kind == TokenKind::Punct) x = x.after(x.punct('+'));
+            if(x.punct('(').kind != TokenKind::Punct) break;
+            x = x.after(x.punct('('));
+            ++open;
+        }
+        Token const n = x.number();
+        if(n.kind != TokenKind::Number) return;
+        x = x.after(n);
+        while(open != 0 && x.punct(')').kind == TokenKind::Punct) {
+            x = x.after(x.punct(')'));
+            --open;
+        }
+        if(open == 0 && x.skip_blanks() == end.lexer().skip_blanks()) {
+            jumps_->target(line, value(n.begin, static_cast<unsigned>(n.end - n.begin)));
+        }
+    }
+
     CONSTEXPR TinyBasicParser line() const
     {
+        PROFILE_RULE(RuleId::Line, line());
         if(failed()) {
             DTRACE("line(): failed state, immediately returning\n");
             return *this;
         }
 
         DTRACE("line(): trying everything\n");
-        auto ret = number().statement().cr()
-            || statement().cr()
-            ;
+        auto ret = first_of(
+                &TinyBasicParser::numbered_line,
+                &TinyBasicParser::unnumbered_line);
         DTRACE("line(): got " PFMT "\n", P(ret));
         return ret;
     }
 
-    CONSTEXPR TinyBasicParser number_helper() const
+    CONSTEXPR TinyBasicParser numbered_line() const
     {
-        if(buf_.empty()) {
-            DTRACE("number_helper(): end of file, leaving it to cr()\n");
-            return *this;
-        }
-        switch(buf_.head()) {
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-                DTRACE("number_helper(): digit, recursing\n");
-                return TinyBasicParser{code_, line_, buf_.tail(), depth_}.number_helper();
-            default:
-                DTRACE("number_helper(): ended\n");
-                return *this;
+        PROFILE_RULE(RuleId::NumberedLine, numbered_line());
+        TinyBasicParser const label = number();
+        AST_KEEP(number_node);
+        TinyBasicParser const body = label.statement();
+        AST_KEEP(statement_node);
+        TinyBasicParser const ret = body.cr();
+        AST_LINK(ret, number_node, statement_node);
+        AST_LINE(ret, 1, offset(text()), number_node);
+        if(jumps_ && ret.good()) {
+            char const* const digits = lexer().skip_blanks();
+            jumps_->label(value(digits, static_cast<unsigned>(label.text() - digits)));
         }
+        return ret;
+    }
+
+    CONSTEXPR TinyBasicParser unnumbered_line() const
+    {
+        PROFILE_RULE(RuleId::UnnumberedLine, unnumbered_line());
+        TinyBasicParser const body = statement();
+        AST_KEEP(statement_node);
+        TinyBasicParser const ret = body.cr();
+        AST_LINE(ret, 0, offset(text()), statement_node);
+        return ret;
     }
 
     CONSTEXPR TinyBasicParser number() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::Number, number());
+        if(empty()) {
             DTRACE("number(): unexpected end of file\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("number(): failed state, immediately return\n");
             return *this;
         }
 
-        Buf b {buf_.tail()};
-        switch(buf_.head())
-        {
-        case ' ':
-        case '\t':
-            DTRACE("number(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.number();
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-            break;
-        default:
-            DTRACE("number(): expecting a number\n");
-            return {Code::ExpectingANumber, line_, buf_, depth_};
-        }
-
-        DTRACE("number(): got a digit, entering helper\n");
-        return TinyBasicParser{code_, line_, buf_.tail(), depth_ + 1}.number_helper();
+        DTRACE("number(): reading a number\n");
+        Token const t = lexer().number();
+        TinyBasicParser const ret = accept(t, TokenKind::Number, Code::ExpectingANumber);
+        AST_NODE(ret, AstKind::Number, 0, offset(t.begin), static_cast<unsigned>(t.end - t.begin));
+        return ret;
     }
 
     CONSTEXPR TinyBasicParser cr() const
     {
+        PROFILE_RULE(RuleId::Cr, cr());
         if(failed()) {
             DTRACE("cr(): failed state, immediately return\n");
             return *this;
         }
-        if(buf_.empty()) {
-            DTRACE("cr(): end of file reached, considering it as final CR\n");
-            return {code_, line_ + 1, buf_, depth_ + 1};
-        }
 
-        switch(buf_.head())
+        Token const t = lexer().newline();
+        switch(t.kind)
         {
-        case ' ':
-        case '\t':
-            DTRACE("cr(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.cr();
-        case '\n':
+        case TokenKind::EndOfFile:
+            DTRACE("cr(): end of file reached, considering it as final CR\n");
+            return advance(t.begin, 1, 1);
+        case TokenKind::Newline:
             DTRACE("cr(): got CR\n");
-            return {code_, line_ + 1, buf_.tail(), depth_ + 1};
+            return advance(t.end, 1, 1);
         default:
             DTRACE("cr(): got something else, error out\n");
-            return {Code::ExpectingEndOfLine, line_, buf_, depth_};
+            return fail(Code::ExpectingEndOfLine, t.begin);
         }
     }
 
+    // Only the statement whose keyword is at the head of the buffer can get
+    // past its first token, so it is the only one worth trying. If there is
+    // none, all of them fail on their keyword, and PRINT's failure is the
+    // one that gets reported, as it comes first.
     CONSTEXPR TinyBasicParser statement() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::Statement, statement());
+        if(empty()) {
             DTRACE("statement(): unexpected end of file\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("statement(): fail state, immediately returning\n");
             return *this;
         }
-        
-        DTRACE("statement(): trying everything\n");
-
-        auto ret = literal("PRINT").expr_list()
-            || literal("DATA").expr_list()
-            || literal("IF").expression().relop().expression().literal("THEN").statement()
-            || literal("GOTO").expression()
-            || literal("INPUT").var_list()
-            || literal("LET").var().literal("=").expression()
-            || literal("GOSUB").expression()
-            || literal("RETURN")
-            || literal("CLEAR")
-            || literal("LIST")
-            || literal("RUN")
-            || literal("END")
-            ;
-
-        DTRACE("statement(): got " PFMT "\n", P(ret));
 
-        return ret;
+        Token const t = lexer().keyword();
+        TinyBasicParser const p = literal(t);
+        DTRACE("statement(): got keyword %s\n", spelling(t.keyword));
+        if(p.good()) {
+            switch(t.keyword)
+            {
+            case Keyword::PRINT:
+            case Keyword::DATA:
+                {
+                    TinyBasicParser const ret = p.expr_list();
+                    AST_NODE(ret, AstKind::Statement, t.keyword, offset(t.begin), AST_LAST());
+                    return ret;
+                }
+            case Keyword::IF:
+                {
+                    TinyBasicParser const left = p.expression();
+                    AST_KEEP(left_node);
+                    TinyBasicParser const op = left.relop();
+                    AST_KEEP(relop_node);
+                    TinyBasicParser const right = op.expression();
+                    AST_KEEP(right_node);
+                    TinyBasicParser const ret = right.keyword(Keyword::THEN).statement();
+                    AST_LINK(ret, left_node, right_node);
+                    AST_ADOPT(ret, relop_node, left_node);
+                    AST_LINK(ret, relop_node, AST_LAST());
+                    AST_NODE(ret, AstKind::Statement, t.keyword, offset(t.begin), relop_node);
+                    return ret;
+                }
+            case Keyword::GOTO:
+            case Keyword::GOSUB:
+                {
+                    TinyBasicParser const ret = p.expression();
+                    AST_NODE(ret, AstKind::Statement, t.keyword, offset(t.begin), AST_LAST());
+                    if(jumps_ && ret.good()) p.jump(t.line, ret);
+                    return ret;
+                }
+            case Keyword::INPUT:
+                {
+                    TinyBasicParser const ret = p.var_list();
+                    AST_NODE(ret, AstKind::Statement, t.keyword, offset(t.begin), AST_LAST());
+                    return ret;
+                }
+            case Keyword::LET:
+                {
+                    TinyBasicParser const target = p.var();
+                    AST_KEEP(var_node);
+                    TinyBasicParser const ret = target.punct('=').expression();
+                    AST_LINK(ret, var_node, AST_LAST());
+                    AST_NODE(ret, AstKind::Statement, t.keyword, offset(t.begin), var_node);
+                    return ret;
+                }
+            case Keyword::RETURN:
+            case Keyword::CLEAR:
+            case Keyword::LIST:
+            case Keyword::RUN:
+            case Keyword::END:
+                AST_NODE(p, AstKind::Statement, t.keyword, offset(t.begin), AstNode::None);
+                return p;
+            default:
+                break;
+            }
+        }
+
+        DTRACE("statement(): not a statement\n");
+        return keyword(Keyword::PRINT);
     }
 
-    CONSTEXPR TinyBasicParser literal(char const* s) const
+    CONSTEXPR TinyBasicParser keyword(Keyword k) const
     {
-        if(buf_.empty()) {
-            DTRACE("literal(%s): unexpected end of file, immediately returning\n", s);
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+        PROFILE_RULE(RuleId::Keyword, keyword(k));
+        if(empty()) {
+            DTRACE("keyword(%s): unexpected end of file, immediately returning\n", spelling(k));
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
-            DTRACE("literal(%s): fail state, immediately returning\n", s);
+            DTRACE("keyword(%s): fail state, immediately returning\n", spelling(k));
             return *this;
         }
 
-        switch(buf_.head()) {
-        case ' ':
-        case '\t':
-            DTRACE("literal(%s): skipping whitespace\n", s);
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.literal(s);
-        }
-        if(*s == '\0') {
-            DTRACE("literal($): done\n");
-            return {code_, line_, buf_, depth_ + 1};
+        DTRACE("keyword(%s): matching\n", spelling(k));
+        return literal(lexer().keyword(k));
+    }
+
+    CONSTEXPR TinyBasicParser punct(char c) const
+    {
+        return punct(c, c);
+    }
+
+    CONSTEXPR TinyBasicParser punct(char c1, char c2) const
+    {
+        PROFILE_RULE(RuleId::Punct, punct(c1, c2));
+        if(empty()) {
+            DTRACE("punct(%c%c): unexpected end of file, immediately returning\n", c1, c2);
+            return with(Code::UnexpectedEndOfFile);
         }
-        if(*s != buf_.head()) {
-            DTRACE("literal(%s): mismatch found\n", s);
-            return {Code::UnknownKeyword, line_, buf_, depth_};
+        if(failed()) {
+            DTRACE("punct(%c%c): fail state, immediately returning\n", c1, c2);
+            return *this;
         }
-        DTRACE("literal(%s): recursing\n", s);
-        return TinyBasicParser{code_, line_, buf_.tail(), depth_}.literal(s + 1);
+
+        DTRACE("punct(%c%c): matching\n", c1, c2);
+        return literal(lexer().punct(c1, c2));
     }
 
     CONSTEXPR TinyBasicParser relop() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::Relop, relop());
+        if(empty()) {
             DTRACE("relop(): unexpected end of file, immediately, returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("relop(): fail state, immediately returning\n");
             return *this;
         }
 
-        switch(buf_.head()) {
-        case ' ':
-        case '\t':
-            DTRACE("relop(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.relop();
-        case '<':
-        case '>':
-            DTRACE("relop(): checking for composed\n");
-            switch(buf_.tail().head()) {
-            case '<':
-            case '>':
-            case '=':
-                DTRACE("relop(): got composed\n");
-                return {code_, line_, buf_.tail().tail(), depth_ + 1};
-            default:
-                DTRACE("relop(): got single\n");
-                return {code_, line_, buf_.tail(), depth_ + 1};
-
-            }
-        case '=':
-            DTRACE("relop(): got single\n");
-            return {code_, line_, buf_.tail(), depth_ + 1};
-        default:
-            DTRACE("relop(): error\n");
-            return {Code::ExpectingRelationalOperator, line_, buf_, depth_};
-        }
+        DTRACE("relop(): reading a relational operator\n");
+        Token const t = lexer().relop();
+        TinyBasicParser const ret = accept(t, TokenKind::Relop, Code::ExpectingRelationalOperator);
+        AST_NODE(ret, AstKind::Relop, Jak::relop(t), offset(t.begin), AstNode::None);
+        return ret;
     }
 
     CONSTEXPR TinyBasicParser var() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::Var, var());
+        if(empty()) {
             DTRACE("var(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("var(): fail state, immediately returning\n");
             return *this;
         }
 
-        switch(buf_.head())
-        {
-        case ' ':
-        case '\t':
-            DTRACE("var(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.var();
-        case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
-        case 'G': case 'H': case 'I': case 'J': case 'K': case 'L':
-        case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R':
-        case 'S': case 'T': case 'U': case 'V': case 'W': case 'X':
-        case 'Y': case 'Z':
-            DTRACE("var(): got variable\n");
-            return {code_, line_, buf_.tail(), depth_ + 1};
-        default:
-            DTRACE("var(): error\n");
-            return {Code::ExpectingAVariable, line_, buf_, depth_};
-        }
+        DTRACE("var(): reading a variable\n");
+        Token const t = lexer().variable();
+        TinyBasicParser const ret = accept(t, TokenKind::Variable, Code::ExpectingAVariable);
+        AST_NODE(ret, AstKind::Var, 0, offset(t.begin), 1);
+        return ret;
     }
 
     CONSTEXPR TinyBasicParser var_list_helper() const
     {
-        if(buf_.empty()) {
-            DTRACE("var_list_helper(): end of file, leaving it to cr()\n");
-            return *this;
-        }
-        if(literal(",").good()) {
-            DTRACE("var_list_helper(): got a comma, continuing\n");
-            auto next = literal(",").var();
-            DTRACE("var_list_helper(): next was " PFMT "\n", P(next));
+        TinyBasicParser p = *this;
+        while(!p.empty()) {
+            AST_KEEP(previous);
+            TinyBasicParser comma = p.punct(',');
+            if(comma.failed()) {
+                TRACE("var_list_helper(): " PFMT " no comma, quitting\n", P(p));
+                return p;
+            }
+            TinyBasicParser next = comma.var();
+            TRACE("var_list_helper(): next was " PFMT "\n", P(next));
             if(next.failed()) return next;
-            DTRACE("var_list_helper(): continuing\n");
-            return next.var_list_helper();
+            AST_LINK(next, previous, AST_LAST());
+            p = next;
         }
-        DTRACE("var_list_helper(): no comma, quitting\n");
-        return *this;
+        TRACE("var_list_helper(): " PFMT " end of file, leaving it to cr()\n", P(p));
+        return p;
     }
 
     CONSTEXPR TinyBasicParser var_list() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::VarList, var_list());
+        if(empty()) {
             DTRACE("var_list(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("var_list(): fail state, immediately returning\n");
@@ -397,244 +774,308 @@ private:
         TinyBasicParser next = var();
         DTRACE("var_list(): next is " PFMT "\n", P(next));
         if(next.failed()) return next;
+        AST_KEEP(first);
         DTRACE("var_list(): entering helper\n");
-        return next.var_list_helper();
-    }
-
-    CONSTEXPR TinyBasicParser expression_helper() const
-    {
-        if(failed()) {
-            DTRACE("expression_helper(): fail state, immediately returning\n");
-            return *this;
-        }
-        if(buf_.empty()) {
-            DTRACE("expression_helper(): end of file, leaving it to cr()\n");
-            return *this;
-        }
-        DTRACE("expression_helper(): trying + or -\n");
-        auto next = literal("+") || literal("-");
-        DTRACE("got " PFMT "\n", P(next));
-        if(next.failed()) return *this;
-        DTRACE("expression_helper(): trying term\n");
-        auto nextnext = next.term();
-        DTRACE("got " PFMT "\n", P(nextnext));
-        if(nextnext.failed()) return nextnext;
-        DTRACE("recursing\n");
-        return nextnext.expression_helper();
+        TinyBasicParser const ret = next.var_list_helper();
+        AST_NODE(ret, AstKind::List, 0, offset(text()), first);
+        return ret;
     }
 
+    // Expressions are parsed by precedence climbing: an optional sign,
+    // then operands separated by binary operators, where binary(n) only
+    // takes operators that bind at least as tightly as n. The recursion
+    // is bounded by the number of precedence levels, plus one expression
+    // per open parenthesis.
     CONSTEXPR TinyBasicParser expression() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::Expression, expression());
+        if(empty()) {
             DTRACE("expression(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("expression(): fail state, immediately returning\n");
             return *this;
         }
 
-        switch(buf_.head())
-        {
-        case ' ':
-        case '\t':
-            DTRACE("expression(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.expression();
-        }
-
-        DTRACE("expression(): trying many things\n");
-        TinyBasicParser next = literal("+").term()
-            || literal("-").term()
-            || term()
-            ;
-        DTRACE("expression(): got " PFMT "\n", P(next));
-        if(next.failed()) return next;
-        DTRACE("expression(): entering helper\n");
-        return next.expression_helper();
-    }
-
-    CONSTEXPR TinyBasicParser term_helper() const
-    {
-        if(buf_.empty()) {
-            DTRACE("term_helper(): end of file, leaing it to cr()\n");
-            return *this;
+        TinyBasicParser p = skip_blanks();
+        if(p.empty()) {
+            TRACE("expression(): " PFMT " unexpected end of file\n", P(p));
+            return p.with(Code::UnexpectedEndOfFile);
         }
-        DTRACE("term_helper(): trying * or /\n");
-        auto next = literal("*") || literal("/");
-        DTRACE("term_helper(): got " PFMT "\n", P(next));
-        if(next.failed()) return *this;
-        DTRACE("term_helper(): trying factor\n");
-        auto nextnext = next.factor();
-        DTRACE("term_helper(): got " PFMT "\n", P(nextnext));
-        if(nextnext.failed()) return nextnext;
-        DTRACE("term_helper(): recursing\n");
-        return nextnext.term_helper();
-    }
 
-    CONSTEXPR TinyBasicParser term() const
-    {
-        if(buf_.empty()) {
-            DTRACE("term(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+        Token const sign = p.lexer().punct('+', '-');
+        if(sign.kind == TokenKind::Punct) {
+            TinyBasicParser next = p.literal(sign);
+            TRACE("expression(): sign gave " PFMT "\n", P(next));
+            // a '-' that leads nowhere loses the tie against the '+'
+            // the grammar would have tried before it
+            if(next.failed() && *sign.begin == '-') {
+                return p.with(Code::UnknownKeyword);
+            }
+            if(next.failed()) return next;
+            if(*sign.begin == '+') return next.binary(1);
+            TinyBasicParser const ret = next.binary(1);
+            AST_NODE(ret, AstKind::Negate, 0, offset(sign.begin), AST_LAST());
+            return ret;
         }
-        if(failed()) {
-            DTRACE("term(): fail state, immediately returning\n");
-            return *this;
+
+        TRACE("expression(): " PFMT " no sign\n", P(p));
+        TinyBasicParser next = p.binary(1);
+        TRACE("expression(): got " PFMT "\n", P(next));
+        if(next.failed() && next.depth() == p.depth()) {
+            TRACE("expression(): not even an operand\n");
+            return p.with(Code::UnknownKeyword);
         }
+        return next;
+    }
 
-        switch(buf_.head())
+    // how tightly an operator token binds; 0 for anything else
+    static CONSTEXPR int precedence(Token const t)
+    {
+        if(t.kind != TokenKind::Punct) return 0;
+        switch(*t.begin)
         {
-        case ' ':
-        case '\t':
-            DTRACE("term(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.term();
+        case '+':
+        case '-':
+            return 1;
+        case '*':
+        case '/':
+            return 2;
+        default:
+            return 0;
         }
+    }
 
-        DTRACE("term(): trying factor\n");
-        TinyBasicParser next = factor();
-        DTRACE("term(): got " PFMT "\n", P(next));
-        if(next.failed()) return next;
-        DTRACE("term(): entering helper\n");
-        return next.term_helper();
+    CONSTEXPR TinyBasicParser binary(int const min) const
+    {
+        PROFILE_RULE(RuleId::Binary, binary(min));
+        TinyBasicParser p = factor();
+        TRACE("binary(%d): got " PFMT "\n", min, P(p));
+        if(p.failed()) return p;
+        while(!p.empty()) {
+            PROFILE_RESUME(RuleId::Binary);
+            AST_KEEP(left);
+            Token const op = p.lexer().arithmetic();
+            int const prec = precedence(op);
+            if(prec < min) {
+                TRACE("binary(%d): " PFMT " no operator, done\n", min, P(p));
+                return p;
+            }
+            TinyBasicParser next = p.literal(op);
+            TRACE("binary(%d): operator gave " PFMT "\n", min, P(next));
+            if(next.failed()) return p;
+            next = next.binary(prec + 1);
+            if(next.failed()) return next;
+            AST_LINK(next, left, AST_LAST());
+            AST_NODE(next, AstKind::Binary, *op.begin, offset(op.begin), left);
+            p = next;
+        }
+        TRACE("binary(%d): " PFMT " end of file, leaving it to cr()\n", min, P(p));
+        return p;
     }
 
     CONSTEXPR TinyBasicParser factor() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::Factor, factor());
+        if(empty()) {
             DTRACE("factor(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("factor(): fail state, immediately returning\n");
             return *this;
         }
 
-        switch(buf_.head())
+        TinyBasicParser p = skip_blanks();
+        if(p.empty()) {
+            TRACE("factor(): " PFMT " unexpected end of file\n", P(p));
+            return p.with(Code::UnexpectedEndOfFile);
+        }
+
+        Token const t = p.lexer().operand();
+        switch(t.kind)
         {
-        case ' ':
-        case '\t':
-            DTRACE("factor(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.factor();
-        }
-
-        DTRACE("factor(): trying many things\n");
-        auto ret = var()
-            || number()
-            || literal("(").expression().literal(")")
-            ;
-        DTRACE("factor(): got " PFMT "\n", P(ret));
-        if(ret.failed()) {
-            DTRACE("factor(): expecting operand, got " PFMT "\n", P(ret));
-            return {Code::ExpectingOperand, ret.line_, ret.buf_, ret.depth_};
+        case TokenKind::Variable:
+        case TokenKind::Number:
+            {
+                DTRACE("factor(): got a variable or a number\n");
+                TinyBasicParser const ret = p.accept(t, t.kind, Code::InternalError);
+                AST_NODE(ret, t.kind == TokenKind::Variable ? AstKind::Var : AstKind::Number, 0,
+                        offset(t.begin), static_cast<unsigned>(t.end - t.begin));
+                return ret;
+            }
+        case TokenKind::Punct:
+            {
+                TinyBasicParser open = p.literal(t);
+                TRACE("factor(): parenthesis gave " PFMT "\n", P(open));
+                if(open.failed()) break;
+                TinyBasicParser ret = open.expression().punct(')');
+                TRACE("factor(): parenthesized expression gave " PFMT "\n", P(ret));
+                if(ret.failed()) {
+                    return ret.with(Code::ExpectingOperand);
+                }
+                return ret;
+            }
+        default:
+            break;
         }
-        return ret;
+        TRACE("factor(): " PFMT " expecting operand\n", P(p));
+        return p.with(Code::ExpectingOperand);
     }
 
     CONSTEXPR TinyBasicParser expr_list_helper() const
     {
-        if(buf_.empty()) {
-            DTRACE("expr_list_helper(): unexpected end of file, leaving it to cr()\n");
-            return *this;
+        TinyBasicParser p = *this;
+        while(!p.empty()) {
+            AST_KEEP(previous);
+            auto next = p.punct(',');
+            TRACE("expr_list_helper(): got " PFMT "\n", P(next));
+            if(next.failed()) return p;
+            auto nextnext = next.first_of(
+                    &TinyBasicParser::string,
+                    &TinyBasicParser::expression);
+            TRACE("expr_list_helper(): got " PFMT "\n", P(nextnext));
+            if(nextnext.failed()) return nextnext;
+            AST_LINK(nextnext, previous, AST_LAST());
+            p = nextnext;
         }
-        DTRACE("expr_list_helper(): trying comma\n");
-        auto next = literal(",");
-        DTRACE("expr_list_helper(): got " PFMT "\n", P(next));
-        if(next.failed()) return *this;
-        DTRACE("expr_list_helper(): trying string or expression\n");
-        auto nextnext = next.string()
-            || next.expression()
-            ;
-        DTRACE("expr_list_helper(): got " PFMT "\n", P(nextnext));
-        if(nextnext.failed()) return nextnext;
-        DTRACE("expr_list_helper(): recursing\n");
-        return nextnext.expr_list_helper();
+        TRACE("expr_list_helper(): " PFMT " end of file, leaving it to cr()\n", P(p));
+        return p;
     }
 
     CONSTEXPR TinyBasicParser expr_list() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::ExprList, expr_list());
+        if(empty()) {
             DTRACE("expr_list(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("expr_list(): fail state, immediately returning\n");
             return *this;
         }
-        
-        switch(buf_.head())
-        {
-        case ' ':
-        case '\t':
-            DTRACE("expr_list(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.expr_list();
-        }
-
-        DTRACE("expr_list(): trying string or expression\n");
-        TinyBasicParser next = string()
-            || expression()
-            ;
-        DTRACE("expr_list(): got " PFMT "\n", P(next));
-        if(next.failed()) return next;
-        DTRACE("expr_list(): entering helper\n");
-        return next.expr_list_helper();
-    }
 
-    CONSTEXPR TinyBasicParser string_helper() const
-    {
-        if(failed()) {
-            DTRACE("string_helper(): fail state, immediately returning\n");
-            return *this;
+        TinyBasicParser p = skip_blanks();
+        if(p.empty()) {
+            TRACE("expr_list(): " PFMT " unexpected end of file\n", P(p));
+            return p.with(Code::UnexpectedEndOfFile);
         }
 
-        if(buf_.empty()) {
-            DTRACE("string_helper(): runaway string\n");
-            return {Code::RunawayString, line_, buf_, depth_};
-        }
-        switch(buf_.head()) {
-        case '"':
-        case '\'':
-            DTRACE("string_helper(): end found\n");
-            return {code_, line_, buf_.tail(), depth_ + 1};
-        case '\n':
-            DTRACE("string_helper(): EOL found\n");
-            return TinyBasicParser{code_, line_ + 1, buf_.tail(), depth_}.string_helper();
-        default:
-            DTRACE("string_helper(): recursing\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.string_helper();
-        }
+        TRACE("expr_list(): " PFMT " trying string or expression\n", P(p));
+        TinyBasicParser next = p.first_of(
+                &TinyBasicParser::string,
+                &TinyBasicParser::expression);
+        TRACE("expr_list(): got " PFMT "\n", P(next));
+        if(next.failed()) return next;
+        AST_KEEP(first);
+        TRACE("expr_list(): entering helper\n");
+        TinyBasicParser const ret = next.expr_list_helper();
+        AST_NODE(ret, AstKind::List, 0, offset(text()), first);
+        return ret;
     }
 
+    // the opening and the closing quote both count as a step
     CONSTEXPR TinyBasicParser string() const
     {
-        if(buf_.empty()) {
+        PROFILE_RULE(RuleId::String, string());
+        if(empty()) {
             DTRACE("string(): unexpected end of file, immediately returning\n");
-            return {Code::UnexpectedEndOfFile, line_, buf_, depth_};
+            return with(Code::UnexpectedEndOfFile);
         }
         if(failed()) {
             DTRACE("string(): fail state, immediately returning\n");
             return *this;
         }
-        
-        switch(buf_.head())
+
+        Token const t = lexer().string();
+        switch(t.kind)
         {
-        case ' ':
-        case '\t':
-            DTRACE("string(): skipping whitespace\n");
-            return TinyBasicParser{code_, line_, buf_.tail(), depth_}.string();
-        case '"':
-        case '\'':
-            DTRACE("string(): head found\n");
-            break;
+        case TokenKind::String:
+            {
+                DTRACE("string(): got a string\n");
+                TinyBasicParser const ret = advance(t.end, t.newlines, 2);
+                AST_NODE(ret, AstKind::String, 0, offset(t.begin + 1),
+                        static_cast<unsigned>(t.end - t.begin) - 2);
+                return ret;
+            }
+        case TokenKind::RunawayString:
+            DTRACE("string(): runaway string\n");
+            return advance(t.end, t.newlines, 1).with(Code::RunawayString);
+        case TokenKind::EndOfFile:
+            DTRACE("string(): unexpected end of file\n");
+            return fail(Code::UnexpectedEndOfFile, t.begin);
         default:
             DTRACE("string(): no quotes found\n");
-            return {Code::ExpectingQuotes, line_, buf_, depth_};
+            return fail(Code::ExpectingQuotes, t.begin);
         }
-
-        DTRACE("string(): entering helper\n");
-        return TinyBasicParser{code_, line_, buf_.tail(), depth_ + 1}.string_helper();
     }
 };
 
+// Once a program has parsed, checks that every GOTO and GOSUB to a
+// literal goes to one of its lines, and fails with UndefinedLine on the
+// line of the first one that does not. Any other result is returned as it
+// is: the lines after one that failed to parse are not known.
+CONSTEXPR unsigned long long check_jumps(unsigned long long const result, Jumps const& jumps)
+{
+    if(UnpackCode(result) != Code::Okay) return result;
+    if(jumps.overflow()) return PackResult(Code::InternalError, UnpackLine(result));
+    for(unsigned k = 0; k != jumps.targets_size_; ++k) {
+        JumpTarget const& j = jumps.targets_[k];
+        if(!jumps.defined(j.target)) return PackResult(Code::UndefinedLine, j.line);
+    }
+    return result;
+}
+
+// how many lines buf has, at most
+CONSTEXPR unsigned line_bound(Buf const buf)
+{
+    unsigned n = 1;
+    for(unsigned i = 0; i != buf.len(); ++i) n += (buf.text()[i] == '\n');
+    return n;
+}
+
+// The result of file() for a whole program, with its jumps checked, for
+// constant expressions; L is how many lines it may have.
+template<unsigned L>
+CONSTEXPR unsigned long long checked_file(Buf const buf)
+{
+    Value labels[L] {};
+    JumpTarget targets[L] {};
+    Jumps jumps(labels, targets, L);
+    return check_jumps(TinyBasicParser(buf, &jumps).file().result(), jumps);
+}
+
+#ifdef JAK_PROFILE
+// the cost of parsing a whole program, e.g. for a static_assert that
+// keeps an eye on it
+CONSTEXPR Profile profile(Buf const buf)
+{
+    Profile prof {};
+    TinyBasicParser(buf, &prof).file();
+    return prof;
+}
+#endif
+
+#ifdef JAK_AST
+// The flat AST of a whole program, for constant expressions. N nodes are
+// enough for up to N - 1 characters, so the size of a string literal
+// will do. Its result is that of file(); when that is an error, only the
+// lines before it are linked from first. The jumps, if any, are gathered
+// on the way.
+template<unsigned N>
+CONSTEXPR Ast<N> ast(Buf const buf, Jumps* jumps = nullptr)
+{
+    Ast<N> ret {};
+    AstArena arena(ret.nodes, N);
+    ret.result = TinyBasicParser(buf, &arena, jumps).file().result();
+    ret.size = arena.size();
+    ret.first = arena.first();
+    ret.overflow = arena.overflow();
+    return ret;
+}
+#endif
+
 } // namespace Jak
 
 #endif
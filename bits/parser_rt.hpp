@@ -25,9 +25,22 @@
    ******************************************************* */
 
 #define CONSTEXPR
-#define TRACE(F, ...) fprintf(stderr, "(%d) " F, __LINE__, ## __VA_ARGS__)
-#define PFMT "[%d, %d, %d, %s]"
-#define P(X) static_cast<int>((X).code()), (X).lineNo(), (X).depth(), (X).buf().text()
-#define DTRACE(F, ...) do{TRACE(PFMT ": " F, P(*this), ## __VA_ARGS__);}while(0)
+#if defined(JAK_NO_TRACE)
+// the empty defaults of parser.hpp, for timings
+#elif defined(JAK_TRACE_RING)
+# include "trace.hpp"
+#else
+# define TRACE(F, ...) fprintf(stderr, "(%d) " F, __LINE__, ## __VA_ARGS__)
+# define PFMT "[%d, %d, %d, %.*s]"
+# define P(X) static_cast<int>((X).code()), (X).lineNo(), (X).depth(), static_cast<int>((X).buf().len()), (X).buf().text()
+# define DTRACE(F, ...) do{TRACE(PFMT ": " F, P(*this), ## __VA_ARGS__);}while(0)
+#endif
+#define PROFILE_CLOCK() static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(\
+            std::chrono::steady_clock::now().time_since_epoch()).count())
+#include <chrono>
 #include <cstdio>
+#include "scan.hpp"
+#include "lexer.hpp"
+#include "profile.hpp"
+#include "ast.hpp"
 #include "parser.hpp"
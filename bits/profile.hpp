@@ -0,0 +1,222 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#ifndef CONSTEXPR
+# define CONSTEXPR constexpr
+#endif
+
+#include <cstdio>
+
+namespace Jak {
+
+// the rules of TinyBasicParser, as far as profiling is concerned
+enum class RuleId {
+    Line,
+    NumberedLine,
+    UnnumberedLine,
+    Number,
+    Cr,
+    Statement,
+    Keyword,
+    Punct,
+    Relop,
+    Var,
+    VarList,
+    Expression,
+    Binary,
+    Factor,
+    ExprList,
+    String,
+    Count
+};
+
+CONSTEXPR char const* name(RuleId r)
+{
+    switch(r)
+    {
+    case RuleId::Line: return "line";
+    case RuleId::NumberedLine: return "numbered_line";
+    case RuleId::UnnumberedLine: return "unnumbered_line";
+    case RuleId::Number: return "number";
+    case RuleId::Cr: return "cr";
+    case RuleId::Statement: return "statement";
+    case RuleId::Keyword: return "keyword";
+    case RuleId::Punct: return "punct";
+    case RuleId::Relop: return "relop";
+    case RuleId::Var: return "var";
+    case RuleId::VarList: return "var_list";
+    case RuleId::Expression: return "expression";
+    case RuleId::Binary: return "binary";
+    case RuleId::Factor: return "factor";
+    case RuleId::ExprList: return "expr_list";
+    case RuleId::String: return "string";
+    default: return "?";
+    }
+}
+
+// What a parse cost, rule by rule: how many times each rule was entered
+// and how many characters it moved past, including the ones that were
+// given up again by backtracking. Characters are booked to the rule
+// entered last, which is the one reading the token. Filled in by
+// profile() when the parser is built with JAK_PROFILE.
+//
+// Calls on a state that had already failed only pass it on, so they
+// count as neither ok() nor failed(). discarded() is what the rule
+// walked over before it failed: the characters from where it started to
+// where it failed, inner rules included, which backtracking throws
+// away. time() is how long its calls took in nanoseconds, inner rules
+// included, and self() the part spent outside of them. Times are only
+// taken in the runtime build (see PROFILE_CLOCK in parser_rt.hpp). A
+// Profile can be handed to the parses of many programs, or summed up
+// with +=, to see what a whole corpus costs.
+struct Profile
+{
+    unsigned calls_[static_cast<int>(RuleId::Count)];
+    unsigned chars_[static_cast<int>(RuleId::Count)];
+    unsigned ok_[static_cast<int>(RuleId::Count)];
+    unsigned failed_[static_cast<int>(RuleId::Count)];
+    unsigned long long discarded_[static_cast<int>(RuleId::Count)];
+    unsigned long long time_[static_cast<int>(RuleId::Count)];
+    unsigned long long self_[static_cast<int>(RuleId::Count)];
+    RuleId current_;
+    // 1 + the rule whose next call runs its body, or 0
+    int pending_;
+    // time spent in calls that returned, which is how leave() tells the
+    // time of the inner rules from that of the rule itself
+    unsigned long long nested_;
+
+    CONSTEXPR unsigned calls(RuleId r) const { return calls_[static_cast<int>(r)]; }
+    CONSTEXPR unsigned chars(RuleId r) const { return chars_[static_cast<int>(r)]; }
+    CONSTEXPR unsigned ok(RuleId r) const { return ok_[static_cast<int>(r)]; }
+    CONSTEXPR unsigned failed(RuleId r) const { return failed_[static_cast<int>(r)]; }
+    CONSTEXPR unsigned long long discarded(RuleId r) const { return discarded_[static_cast<int>(r)]; }
+    CONSTEXPR unsigned long long time(RuleId r) const { return time_[static_cast<int>(r)]; }
+    CONSTEXPR unsigned long long self(RuleId r) const { return self_[static_cast<int>(r)]; }
+
+    CONSTEXPR unsigned calls() const
+    {
+        unsigned n = 0;
+        for(int i = 0; i != static_cast<int>(RuleId::Count); ++i) n += calls_[i];
+        return n;
+    }
+
+    CONSTEXPR unsigned chars() const
+    {
+        unsigned n = 0;
+        for(int i = 0; i != static_cast<int>(RuleId::Count); ++i) n += chars_[i];
+        return n;
+    }
+
+    CONSTEXPR void enter(RuleId r)
+    {
+        ++calls_[static_cast<int>(r)];
+        current_ = r;
+    }
+
+    CONSTEXPR void resume(RuleId r)
+    {
+        current_ = r;
+    }
+
+    CONSTEXPR void consume(unsigned n)
+    {
+        chars_[static_cast<int>(current_)] += n;
+    }
+
+    // true if r is to be called again to see what it returns, false for
+    // that call, which runs the body
+    CONSTEXPR bool wrap(RuleId r)
+    {
+        if(pending_ == static_cast<int>(r) + 1) {
+            pending_ = 0;
+            return false;
+        }
+        pending_ = static_cast<int>(r) + 1;
+        return true;
+    }
+
+    CONSTEXPR unsigned long long nested() const
+    {
+        return nested_;
+    }
+
+    // books a call of r that started on a good state or not, failed or
+    // not, after span characters and time nanoseconds; nested is what
+    // nested() was when it started
+    CONSTEXPR void leave(RuleId r, bool good, bool failed, unsigned span,
+            unsigned long long time, unsigned long long nested)
+    {
+        int const i = static_cast<int>(r);
+        if(good && failed) {
+            ++failed_[i];
+            discarded_[i] += span;
+        } else if(good) {
+            ++ok_[i];
+        }
+        time_[i] += time;
+        self_[i] += time - (nested_ - nested);
+        nested_ = nested + time;
+    }
+
+    CONSTEXPR Profile& operator+=(Profile const& p)
+    {
+        for(int i = 0; i != static_cast<int>(RuleId::Count); ++i) {
+            calls_[i] += p.calls_[i];
+            chars_[i] += p.chars_[i];
+            ok_[i] += p.ok_[i];
+            failed_[i] += p.failed_[i];
+            discarded_[i] += p.discarded_[i];
+            time_[i] += p.time_[i];
+            self_[i] += p.self_[i];
+        }
+        return *this;
+    }
+};
+
+// the counters of a Profile as a table, one row per rule, for the
+// runtime build
+inline void report(FILE* f, Profile const& prof)
+{
+    fprintf(f, "%-16s %10s %10s %10s %10s %10s %10s %10s\n",
+            "rule", "calls", "ok", "failed", "chars", "discarded", "time ms", "self ms");
+    unsigned long long discarded = 0, self = 0;
+    for(int i = 0; i != static_cast<int>(RuleId::Count); ++i) {
+        RuleId const r = static_cast<RuleId>(i);
+        fprintf(f, "%-16s %10u %10u %10u %10u %10llu %10.3f %10.3f\n",
+                name(r), prof.calls(r), prof.ok(r), prof.failed(r), prof.chars(r),
+                prof.discarded(r), prof.time(r) / 1e6, prof.self(r) / 1e6);
+        discarded += prof.discarded(r);
+        self += prof.self(r);
+    }
+    fprintf(f, "%-16s %10u %10s %10s %10u %10llu %10s %10.3f\n",
+            "total", prof.calls(), "", "", prof.chars(), discarded, "", self / 1e6);
+}
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,271 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+// Vectorized scanning for the runtime build. Include it before
+// lexer.hpp (parser_rt.hpp does so); it fills in the SCAN_* hooks that
+// lexer.hpp otherwise defines as plain loops. Define JAK_NO_SIMD to keep
+// the plain loops.
+//
+// Every Lexer method skips blanks, and a call in there, or much code,
+// keeps the compiler from inlining the Lexer into the parser, which
+// costs more than vectors save. So runs of blanks are looked at with
+// SSE2 inline, and only once they are two characters long; SSE2 comes
+// with every x86-64 processor. Strings are long enough to be worth a
+// call: their first 16 characters are looked at with SSE2 too, and the
+// rest of a long one goes through the routine picked the first time one
+// is needed, from what the processor supports: AVX2, SSE2 or a plain
+// loop.
+// Runs of digits are too short for any of this to pay off.
+//
+// Nothing is ever read past the end of the source, which may be the end
+// of a mapped file.
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# define JAK_SCAN_SSE2
+# include <immintrin.h>
+#endif
+
+namespace Jak {
+namespace Scan {
+
+enum class Isa { Scalar, SSE2, AVX2 };
+
+inline bool blank(char c) { return c == ' ' || c == '\t'; }
+inline bool quote(char c) { return c == '"' || c == '\''; }
+
+// Each routine returns the length of the run at s, out of n characters.
+// The string routines end the run at either quote and count the newlines
+// in it into newlines.
+
+inline unsigned blanks_scalar(char const* s, unsigned n)
+{
+    unsigned i = 0;
+    while(i != n && blank(s[i])) ++i;
+    return i;
+}
+
+inline unsigned string_scalar(char const* s, unsigned n, int& newlines)
+{
+    unsigned i = 0;
+    while(i != n && !quote(s[i])) {
+        newlines += (s[i] == '\n');
+        ++i;
+    }
+    return i;
+}
+
+#ifdef JAK_SCAN_SSE2
+
+inline __m128i load(char const* s)
+{
+    return _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+}
+
+// a bit set for every character of the block that is in the run
+inline unsigned blanks_mask(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))));
+}
+
+inline unsigned quotes_mask(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\''))));
+}
+
+inline unsigned newlines_mask(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+inline unsigned blanks_sse2(char const* s, unsigned n)
+{
+    unsigned i = 0;
+    for(; n - i >= 16; i += 16) {
+        unsigned const in = blanks_mask(load(s + i));
+        if(in != 0xFFFF) return i + __builtin_ctz(~in);
+    }
+    return i + blanks_scalar(s + i, n - i);
+}
+
+inline unsigned string_sse2(char const* s, unsigned n, int& newlines)
+{
+    unsigned i = 0;
+    for(; n - i >= 16; i += 16) {
+        __m128i const v = load(s + i);
+        unsigned const end = quotes_mask(v);
+        unsigned const nl = newlines_mask(v);
+        if(end) {
+            unsigned const k = __builtin_ctz(end);
+            newlines += __builtin_popcount(nl & ((1u << k) - 1));
+            return i + k;
+        }
+        newlines += __builtin_popcount(nl);
+    }
+    return i + string_scalar(s + i, n - i, newlines);
+}
+
+__attribute__((target("avx2")))
+inline unsigned string_avx2(char const* s, unsigned n, int& newlines)
+{
+    __m256i const dquote = _mm256_set1_epi8('"');
+    __m256i const squote = _mm256_set1_epi8('\'');
+    __m256i const newline = _mm256_set1_epi8('\n');
+    unsigned i = 0;
+    for(; n - i >= 32; i += 32) {
+        __m256i const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i));
+        unsigned const end = _mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, dquote), _mm256_cmpeq_epi8(v, squote)));
+        unsigned const nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        if(end) {
+            unsigned const k = __builtin_ctz(end);
+            newlines += __builtin_popcount(nl & ((1u << k) - 1));
+            return i + k;
+        }
+        newlines += __builtin_popcount(nl);
+    }
+    return i + string_sse2(s + i, n - i, newlines);
+}
+
+#endif
+
+// what the rest of a long string goes through
+typedef unsigned (*StringScanner)(char const*, unsigned, int&);
+
+// the best of the routines that the processor supports, up to most
+inline Isa pick(Isa most, StringScanner& string)
+{
+#ifdef JAK_SCAN_SSE2
+    __builtin_cpu_init();
+    if(most >= Isa::AVX2 && __builtin_cpu_supports("avx2")) {
+        string = &string_avx2;
+        return Isa::AVX2;
+    }
+    if(most >= Isa::SSE2) {
+        string = &string_sse2;
+        return Isa::SSE2;
+    }
+#else
+    (void)most;
+#endif
+    string = &string_scalar;
+    return Isa::Scalar;
+}
+
+struct Active
+{
+    StringScanner string;
+    Isa isa;
+};
+
+// Picked the first time it is needed rather than by the initializer of a
+// static, which may run after that of a static elsewhere that already
+// parses something. select() lets benchmarks compare the routines.
+inline Active& active()
+{
+    static Active a = [] {
+        Active ret {nullptr, Isa::Scalar};
+        ret.isa = pick(Isa::AVX2, ret.string);
+        return ret;
+    }();
+    return a;
+}
+
+inline Isa select(Isa most)
+{
+    Active& a = active();
+    return a.isa = pick(most, a.string);
+}
+
+inline Isa selected()
+{
+    return active().isa;
+}
+
+inline char const* name(Isa isa)
+{
+    switch(isa)
+    {
+    case Isa::Scalar: return "scalar";
+    case Isa::SSE2: return "sse2";
+    case Isa::AVX2: return "avx2";
+    }
+    return "?";
+}
+
+// the whole of a run of blanks
+inline unsigned blanks(char const* s, unsigned n)
+{
+#ifdef JAK_SCAN_SSE2
+    return blanks_sse2(s, n);
+#else
+    return blanks_scalar(s, n);
+#endif
+}
+
+// the whole body of a string, up to its closing quote
+__attribute__((noinline))
+inline unsigned string(char const* s, unsigned n, int& newlines)
+{
+#ifdef JAK_SCAN_SSE2
+    if(n >= 16) {
+        __m128i const v = load(s);
+        unsigned const end = quotes_mask(v);
+        unsigned const nl = newlines_mask(v);
+        if(end) {
+            unsigned const k = __builtin_ctz(end);
+            newlines += __builtin_popcount(nl & ((1u << k) - 1));
+            return k;
+        }
+        newlines += __builtin_popcount(nl);
+        return 16 + active().string(s + 16, n - 16, newlines);
+    }
+#endif
+    return string_scalar(s, n, newlines);
+}
+
+} // namespace Scan
+} // namespace Jak
+
+#ifndef JAK_NO_SIMD
+# define SCAN_BLANKS(S, N) do{\
+    if(N > 1 && ::Jak::Scan::blank(S[0]) && ::Jak::Scan::blank(S[1])) {\
+        unsigned const k_ = ::Jak::Scan::blanks(S, N); S += k_; N -= k_;\
+    } else if(N != 0 && ::Jak::Scan::blank(*S)) {\
+        ++S; --N;\
+    }\
+}while(0)
+# define SCAN_STRING(S, N, NEWLINES) do{\
+    unsigned const k_ = ::Jak::Scan::string(S, N, NEWLINES); S += k_; N -= k_;\
+}while(0)
+#endif
+
+#endif
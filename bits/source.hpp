@@ -0,0 +1,153 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include "buffer.hpp"
+#include <climits>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <cerrno>
+#endif
+
+namespace Jak {
+
+// A file mapped read only into memory, for the runtime build. The parser
+// is bounded by the length of its Buf, so the mapping is used as is:
+// nothing is copied and no NUL needs to follow the last character.
+// ok() tells whether the file could be mapped; error() holds errno (or
+// GetLastError()) otherwise. An empty file maps to an empty Buf.
+struct MappedSource
+{
+    char const* s_;
+    unsigned len_;
+    int error_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+
+    explicit MappedSource(char const* path)
+        : s_("")
+          , len_(0)
+          , error_(0)
+#ifdef _WIN32
+          , file_(INVALID_HANDLE_VALUE)
+          , mapping_(nullptr)
+#endif
+    {
+#ifdef _WIN32
+        file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file_ == INVALID_HANDLE_VALUE) {
+            error_ = static_cast<int>(GetLastError());
+            return;
+        }
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file_, &size)) {
+            error_ = static_cast<int>(GetLastError());
+            return;
+        }
+        if(size.QuadPart > UINT_MAX) {
+            error_ = ERROR_FILE_TOO_LARGE;
+            return;
+        }
+        if(size.QuadPart == 0) return;
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mapping_) {
+            error_ = static_cast<int>(GetLastError());
+            return;
+        }
+        void* p = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        if(!p) {
+            error_ = static_cast<int>(GetLastError());
+            return;
+        }
+        s_ = static_cast<char const*>(p);
+        len_ = static_cast<unsigned>(size.QuadPart);
+#else
+        int const fd = open(path, O_RDONLY);
+        if(fd < 0) {
+            error_ = errno;
+            return;
+        }
+        struct stat st;
+        if(fstat(fd, &st) < 0) {
+            error_ = errno;
+        } else if(static_cast<unsigned long long>(st.st_size) > UINT_MAX) {
+            error_ = EFBIG;
+        } else if(st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p == MAP_FAILED) {
+                error_ = errno;
+            } else {
+                s_ = static_cast<char const*>(p);
+                len_ = static_cast<unsigned>(st.st_size);
+            }
+        }
+        // the mapping outlives the descriptor
+        close(fd);
+#endif
+    }
+
+    MappedSource(MappedSource const&) = delete;
+    MappedSource& operator=(MappedSource const&) = delete;
+
+    ~MappedSource()
+    {
+#ifdef _WIN32
+        if(len_) UnmapViewOfFile(s_);
+        if(mapping_) CloseHandle(mapping_);
+        if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if(len_) munmap(const_cast<char*>(s_), len_);
+#endif
+    }
+
+    bool ok() const
+    {
+        return error_ == 0;
+    }
+
+    int error() const
+    {
+        return error_;
+    }
+
+    Buf buf() const
+    {
+        return {s_, len_};
+    }
+};
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,171 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+// A push parser for the runtime build, for sources that come in pieces
+// (from a pipe, say) or that are too large to keep in memory. Include it
+// after parser.hpp.
+//
+// Lines do not depend on each other, so each line is parsed with file()
+// as soon as its end has been seen, with its line number added on. The
+// end of a line is a newline outside a string. Either quote opens a
+// string and either one closes it, so this only needs to know whether an
+// odd number of quotes has come by. Only a partial line is kept between
+// feeds, so memory grows with the longest line rather than with the
+// source. parallel.hpp splits a source the same way.
+//
+//     StreamParser sp;
+//     while(size_t n = fread(buf, 1, sizeof(buf), stdin)) {
+//         if(!sp.feed(buf, n)) break;
+//     }
+//     unsigned long long result = sp.finish();
+//
+// finish() returns what TinyBasicParser(...).file().result() returns
+// for the whole source. The one exception is size: a single line longer
+// than TinyBasicParser::MaxSourceLength gives SourceTooLarge on its own
+// line, not the whole source on line 1.
+
+#include <string>
+
+namespace Jak {
+
+class StreamParser
+{
+public:
+    // Feeds the next n characters. done(result) is called with the
+    // packed Code and first line of every line that ends in them, up to
+    // and including the first one that fails. Returns false once a line
+    // has failed: nothing more needs to be fed.
+    template<typename Done>
+    bool feed(char const* s, size_t n, Done const& done)
+    {
+        char const* const end = s + n;
+        char const* line = s;
+        while(!failed() && s != end) {
+            char const c = *s++;
+            if(c == '"' || c == '\'') {
+                odd_ = !odd_;
+            } else if(c == '\n') {
+                ++newlines_;
+                if(odd_) continue;
+                if(carry_.empty()) {
+                    parse(line, static_cast<size_t>(s - line), done);
+                } else {
+                    carry_.append(line, s);
+                    parse(carry_.data(), carry_.size(), done);
+                    carry_.clear();
+                }
+                line = s;
+            }
+        }
+        if(!failed() && line != end) {
+            if(carry_.size() + (end - line) > TinyBasicParser::MaxSourceLength) {
+                result_ = PackResult(Code::SourceTooLarge, line_);
+                done(result_);
+            } else {
+                carry_.append(line, end);
+            }
+        }
+        return !failed();
+    }
+
+    bool feed(char const* s, size_t n)
+    {
+        return feed(s, n, [](unsigned long long) {});
+    }
+
+    // Ends the source: parses what is left of the last line and returns
+    // the packed result for the whole of it.
+    unsigned long long finish()
+    {
+        if(!failed()) {
+            // file() counts a last line without a newline as well
+            result_ = carry_.empty()
+                ? PackResult(Code::Okay, line_)
+                : parse(carry_.data(), carry_.size());
+            carry_.clear();
+        }
+        return result_;
+    }
+
+    // the first failure, or Okay so far
+    unsigned long long result() const
+    {
+        return result_;
+    }
+
+    bool failed() const
+    {
+        return UnpackCode(result_) != Code::Okay;
+    }
+
+    // the line number of the line that is being read
+    int line() const
+    {
+        return line_;
+    }
+
+    // the part of that line that has been fed so far, the memory this
+    // holds on to
+    size_t carried() const
+    {
+        return carry_.size();
+    }
+
+private:
+    // the result of file() on one line, or the rest of the source, put
+    // on the line where it starts; parsed from line 1, so that a long
+    // source cannot run out of the line bits of the parser
+    unsigned long long parse(char const* s, size_t n) const
+    {
+        unsigned long long const r = TinyBasicParser(Buf(s, static_cast<unsigned>(n))).file().result();
+        return PackResult(UnpackCode(r), UnpackLine(r) + line_ - 1);
+    }
+
+    template<typename Done>
+    void parse(char const* s, size_t n, Done const& done)
+    {
+        unsigned long long const r = parse(s, n);
+        if(UnpackCode(r) == Code::Okay) {
+            done(PackResult(Code::Okay, line_));
+        } else {
+            result_ = r;
+            done(r);
+        }
+        line_ = newlines_ + 1;
+    }
+
+    std::string carry_;
+    bool odd_ = false;
+    int newlines_ = 0;
+    int line_ = 1;
+    unsigned long long result_ = PackResult(Code::Okay, 1);
+};
+
+} // namespace Jak
+
+#endif
@@ -0,0 +1,119 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef TEST_CASES_HPP
+#define TEST_CASES_HPP
+
+#include "buffer.hpp"
+#include "validate.hpp"
+
+namespace Jak {
+
+// The runtime test cases, with what file() has to give for them. Run by
+// bits/test_rt.cpp; bench/steps.cpp counts the parser steps they take.
+// A case with a chunk size is fed to a StreamParser that many characters
+// at a time instead.
+struct TestCase
+{
+    int id;
+    char const* name;
+    char const* source;
+    unsigned len;
+    unsigned chunk;
+    Code code;
+    int line;
+
+    Buf buf() const
+    {
+        return {source, len};
+    }
+};
+
+// a string literal and its length
+#define JAK_SOURCE(S) S, sizeof(S) - 1
+
+// only the first two lines are the source of case 8: nothing past its
+// length may be looked at, and it does not end in a NUL
+static char const test_case_prefix[] = "\
+10 PRINT 'Hello, World!'\n\
+20 GOTO 10\n\
+30 PIRNT 'not part of the source'\n";
+
+static TestCase const test_cases[] = {
+    { 1, "hello", JAK_SOURCE("10 PRINT 'Hello, World!'"), 0, Code::Okay, 2 },
+    { 2, "hello-goto", JAK_SOURCE("\
+10 PRINT 'Hello, World!'\n\
+20 GOTO 10"),
+    0, Code::Okay, 3 },
+    { 3, "final-newline", JAK_SOURCE("\
+10 PRINT 'Hello, World!'\n\
+20 GOTO 10\n"),
+    0, Code::Okay, 3 },
+    { 4, "unknown-keyword", JAK_SOURCE("\
+10 PIRNT 'Hello, World!'"),
+    0, Code::UnknownKeyword, 1 },
+    { 5, "let-print", JAK_SOURCE("\
+10 LET X = 1 + 2\n\
+20 PRINT X"),
+    0, Code::Okay, 3 },
+    { 6, "missing-operand", JAK_SOURCE("\
+10 LET X = 1 + \n\
+20 PRINT X"),
+    0, Code::ExpectingOperand, 1 },
+    { 7, "missing-operand-line-2", JAK_SOURCE("\
+5  LET Y = 3\n\
+10 LET X = Y + \n\
+20 PRINT X"),
+    0, Code::ExpectingOperand, 2 },
+    { 8, "bounded-source", test_case_prefix, 36, 0, Code::Okay, 3 },
+    // runs of blanks and strings long enough for the vector code of
+    // scan.hpp, with the newlines inside the string counted
+    { 9, "long-blanks-and-string", JAK_SOURCE("\
+10 PRINT \"a string that goes on for long enough\n\
+to span lines, and to take more than a couple\n\
+of blocks to get through\", X\n\
+20                                        GOTO 10\n\
+30 PIRNT X"),
+    0, Code::UnknownKeyword, 5 },
+    // pieces that end inside keywords, numbers and the string
+    { 10, "stream-error", JAK_SOURCE("\
+10 PRINT \"a string over\n\
+20 two lines\", X\n\
+30 LET X = 12345\n\
+40 PIRNT X\n\
+50 GOTO 10\n"),
+    3, Code::UnknownKeyword, 4 },
+    { 11, "stream-okay", JAK_SOURCE("\
+10 PRINT \"a string over\n\
+20 two lines\", X\n\
+30 LET X = 12345"),
+    5, Code::Okay, 4 },
+};
+
+#undef JAK_SOURCE
+
+} // namespace Jak
+
+#endif
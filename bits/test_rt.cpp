@@ -1,66 +1,53 @@
 #include "buffer.hpp"
 #include "validate.hpp"
 #include "parser_rt.hpp"
+#include "stream.hpp"
+#include "test_cases.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #ifdef _WIN32
 # include <windows.h>
 #endif
 
-#ifndef TEST
-# error "Please specify a test."
-#endif
-
-#define TESTCASE(S, C, L)\
-    TinyBasicParser p(Buf(S));\
-    auto refCode = C;\
-    int refLine = L;\
-    auto rv = p.file();\
-    auto code = rv.code();\
-    auto line = rv.lineNo();\
-    auto source = p.buf().text()
+// Runs the cases of test_cases.hpp, or those named on the command line
+// (by number, or by a part of their name), and prints PASS or FAIL for
+// each. -r n runs every case n times and prints the fastest and the
+// median time of a run in nanoseconds; -v prints the source and what
+// the parser gave. Build with -DJAK_NO_TRACE for timings that mean
+// something (testrt.bat does).
 
 using namespace Jak;
-int main()
+
+namespace {
+
+unsigned long long parse(TestCase const& c)
+{
+    if(c.chunk == 0) return TinyBasicParser(c.buf()).file().result();
+    StreamParser sp;
+    for(unsigned i = 0; i < c.len && sp.feed(c.source + i,
+                i + c.chunk < c.len ? c.chunk : c.len - i); i += c.chunk) {}
+    return sp.finish();
+}
+
+bool selected(TestCase const& c, std::vector<char const*> const& filters)
+{
+    if(filters.empty()) return true;
+    for(char const* f : filters) {
+        // a number only picks the case with that id, not the names with
+        // it in them
+        bool const number = f[strspn(f, "0123456789")] == '\0';
+        if(number ? atoi(f) == c.id : strstr(c.name, f) != nullptr) return true;
+    }
+    return false;
+}
+
+void print_pass(bool pass)
 {
-#if TEST == 1
-    TESTCASE("10 PRINT 'Hello, World!'", Code::Okay, 2);
-#elif TEST == 2
-    TESTCASE("\
-10 PRINT 'Hello, World!'\n\
-20 GOTO 10",
-    Code::Okay, 3);
-#elif TEST == 3
-    TESTCASE("\
-10 PRINT 'Hello, World!'\n\
-20 GOTO 10\n",
-    Code::Okay, 3);
-#elif TEST == 4
-    TESTCASE("\
-10 PIRNT 'Hello, World!'",
-    Code::UnknownKeyword, 1);
-#elif TEST == 5
-    TESTCASE("\
-10 LET X = 1 + 2\n\
-20 PRINT X",
-    Code::Okay, 3);
-#elif TEST == 6
-    TESTCASE("\
-10 LET X = 1 + \n\
-20 PRINT X",
-    Code::ExpectingOperand, 1);
-#elif TEST == 7
-    TESTCASE("\
-5  LET Y = 3\n\
-10 LET X = Y + \n\
-20 PRINT X",
-    Code::ExpectingOperand, 2);
-#endif
-#ifdef PRINT_INFO
-    printf("source =\n%s$\n", source);
-    printf("code = %d line = %d\n", static_cast<int>(code), line);
-    printf("\n");
-#endif
-    auto pass = (code == refCode && line == refLine);
 #ifdef _WIN32
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     auto h = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -72,5 +59,74 @@ int main()
 #ifdef _WIN32
     SetConsoleTextAttribute(h, csbi.wAttributes);
 #endif
-    printf("\n");
+}
+
+int usage(char const* self)
+{
+    fprintf(stderr, "usage: %s [-v] [-r repeats] [case...]\n", self);
+    return 255;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    bool info = false;
+    unsigned repeats = 1;
+    std::vector<char const*> filters;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-v") == 0) info = true;
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc) repeats = static_cast<unsigned>(atoi(argv[++i]));
+        else if(argv[i][0] == '-') return usage(argv[0]);
+        else filters.push_back(argv[i]);
+    }
+    if(repeats == 0) return usage(argv[0]);
+
+    unsigned passed = 0, failed = 0;
+    for(auto&& c : test_cases) {
+        if(!selected(c, filters)) continue;
+
+#ifdef JAK_TRACE_RING
+        Trace::Ring::instance().clear();
+#endif
+        unsigned long long result = 0;
+        std::vector<double> ns;
+        for(unsigned r = 0; r != repeats; ++r) {
+            auto const t0 = Clock::now();
+            result = parse(c);
+            ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+        }
+        std::sort(ns.begin(), ns.end());
+        Code const code = UnpackCode(result);
+        int const line = UnpackLine(result);
+
+        if(info) {
+            printf("source =\n%.*s$\n", static_cast<int>(c.len), c.source);
+            printf("code = %d line = %d\n", static_cast<int>(code), line);
+            printf("\n");
+        }
+#ifdef JAK_TRACE_RING
+        // tools/trace.cpp reads it back
+        std::string const dump = std::string(c.name) + ".jtr";
+        if(!Trace::dump(dump.c_str())) perror(dump.c_str());
+#endif
+#ifdef JAK_PROFILE
+        report(stdout, profile(c.buf()));
+        printf("\n");
+#endif
+
+        bool const pass = code == c.code && line == c.line;
+        (pass ? passed : failed)++;
+        print_pass(pass);
+        if(repeats > 1) {
+            printf(" %2d %-24s %10.0f min %10.0f median ns\n",
+                    c.id, c.name, ns.front(), ns[ns.size() / 2]);
+        } else {
+            printf(" %2d %s\n", c.id, c.name);
+        }
+    }
+    printf("%u passed, %u failed\n", passed, failed);
+    return failed ? 1 : 0;
 }
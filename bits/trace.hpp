@@ -0,0 +1,324 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// A binary backend for TRACE and DTRACE, for the runtime build. Include
+// it where parser_rt.hpp would define the fprintf ones (it does so for
+// JAK_TRACE_RING). Nothing is formatted while parsing. Every trace point
+// writes one fixed size Record into a ring buffer of the thread: when it
+// was hit, which point it was, the source being parsed, and its
+// arguments as they are. A parser state takes its word, which packs the
+// code, line, depth and offset; the offset is into that source. Once the
+// ring is full, the oldest records are overwritten.
+//
+// Every parser made from a Buf shows it to TRACE_SOURCE, which keeps a
+// copy of it unless it is the same as the last one. That is what makes
+// the offsets of StreamParser lines and of parallel.hpp pieces mean
+// something: they are parsed from buffers of their own, which may well be
+// reused for the next line by the time of a dump. Only the bytes are
+// compared, and only when the Buf is where the last one was. A copy goes
+// once no record left in the ring refers to it, so memory stays bounded
+// by what the ring holds.
+//
+// dump() writes the ring to a file, along with the format of every point
+// in it and the sources. tools/trace.cpp turns that back into the text
+// of the fprintf backend, or into Chrome trace JSON.
+//
+// Each point is a static Point with its format string and function, so
+// a record only needs a pointer to it. In the constexpr build TRACE and
+// DTRACE keep the empty defaults of parser.hpp, so none of this is there.
+
+#include "buffer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+// records kept per thread, a power of two
+#ifndef JAK_TRACE_RECORDS
+# define JAK_TRACE_RECORDS (1u << 16)
+#endif
+
+namespace Jak {
+
+namespace Trace {
+
+struct Point
+{
+    char const* format;
+    char const* function;
+    int line;
+};
+
+// what P(X) passes for a parser state
+struct State
+{
+    unsigned long long word;
+};
+
+// Arguments are taken in the order of the format: %P is the word of a
+// State, %d and %c an integer, %s up to 8 characters of a string.
+enum : unsigned { MaxArgs = 4 };
+
+struct Record
+{
+    unsigned long long time;
+    Point const* point;
+    unsigned long long args[MaxArgs];
+    // which of the sources the states are in, counted since the last
+    // clear()
+    unsigned source;
+};
+
+class Ring
+{
+public:
+    static_assert((JAK_TRACE_RECORDS & (JAK_TRACE_RECORDS - 1)) == 0,
+            "JAK_TRACE_RECORDS must be a power of two");
+
+    static Ring& instance()
+    {
+        static thread_local Ring ring;
+        return ring;
+    }
+
+    struct Source
+    {
+        char const* base;
+        std::string text;
+        // written() when it became the current one
+        unsigned long long first;
+    };
+
+    Record& next()
+    {
+        Record& r = records_[written_++ & (JAK_TRACE_RECORDS - 1)];
+        r.source = dropped_ + static_cast<unsigned>(sources_.size()) - 1;
+        return r;
+    }
+
+    // the source that the records from now on are about
+    void source(Buf const buf)
+    {
+        if(!sources_.empty() && sources_.back().base == buf.text()
+                && sources_.back().text.size() == buf.len()
+                && memcmp(sources_.back().text.data(), buf.text(), buf.len()) == 0) {
+            return;
+        }
+        // the current one if nothing refers to it yet, and the oldest ones
+        // once the records after them are all that is left
+        if(!sources_.empty() && sources_.back().first == written_) {
+            sources_.pop_back();
+        }
+        unsigned long long const oldest = written_ - kept();
+        while(!sources_.empty() && (sources_.size() == 1 ? written_ : sources_[1].first) <= oldest) {
+            sources_.pop_front();
+            ++dropped_;
+        }
+        sources_.push_back(Source{buf.text(), std::string(buf.text(), buf.len()), written_});
+    }
+
+    // the sources the records still kept may refer to, oldest first;
+    // Record::source counts dropped() more
+    std::deque<Source> const& sources() const
+    {
+        return sources_;
+    }
+
+    unsigned dropped() const
+    {
+        return dropped_;
+    }
+
+    // records written since the last clear(), some maybe overwritten
+    unsigned long long written() const
+    {
+        return written_;
+    }
+
+    unsigned long long kept() const
+    {
+        return written_ < JAK_TRACE_RECORDS ? written_ : JAK_TRACE_RECORDS;
+    }
+
+    // the i-th oldest record still kept
+    Record const& operator[](unsigned long long i) const
+    {
+        return records_[(written_ - kept() + i) & (JAK_TRACE_RECORDS - 1)];
+    }
+
+    void clear()
+    {
+        written_ = 0;
+        sources_.clear();
+        dropped_ = 0;
+    }
+
+private:
+    Ring()
+        : records_(JAK_TRACE_RECORDS)
+          , written_(0)
+          , dropped_(0)
+    {}
+
+    std::vector<Record> records_;
+    unsigned long long written_;
+    std::deque<Source> sources_;
+    unsigned dropped_;
+};
+
+inline unsigned long long now()
+{
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline unsigned long long arg(State s)
+{
+    return s.word;
+}
+
+inline unsigned long long arg(char const* s)
+{
+    unsigned long long ret = 0;
+    char* const out = reinterpret_cast<char*>(&ret);
+    for(unsigned i = 0; i != sizeof(ret) && s[i]; ++i) out[i] = s[i];
+    return ret;
+}
+
+template<typename T>
+inline unsigned long long arg(T const v)
+{
+    return static_cast<unsigned long long>(v);
+}
+
+template<typename... Args>
+inline void record(Point const& point, Args const... args)
+{
+    static_assert(sizeof...(Args) <= MaxArgs, "too many arguments for a trace record");
+    Record& r = Ring::instance().next();
+    r.time = now();
+    r.point = &point;
+    unsigned long long const packed[MaxArgs + 1] = { arg(args)... };
+    memcpy(r.args, packed, sizeof(r.args));
+}
+
+// The file dump() writes, all in the byte order of the machine:
+//
+//     Header
+//     header.sources times: its length as an unsigned, then the source
+//     header.points times: PointHeader, then its function and format
+//     header.records times: Record, oldest first
+//
+// A Record names its point by the address in PointHeader::id, and its
+// source by its index.
+struct Header
+{
+    char magic[8];
+    unsigned version;
+    unsigned record_size;
+    unsigned long long written;
+    unsigned long long records;
+    unsigned sources;
+    unsigned points;
+};
+
+struct PointHeader
+{
+    unsigned long long id;
+    int line;
+    unsigned function;
+    unsigned format;
+};
+
+static char const Magic[8] = { 'J', 'A', 'K', 'T', 'R', 'A', 'C', 'E' };
+enum : unsigned { Version = 2 };
+
+// Writes what the ring of this thread holds to path, with the sources
+// for the decoder to show the rest of the text after each offset.
+// Returns false if the file cannot be written.
+inline bool dump(char const* path)
+{
+    Ring const& ring = Ring::instance();
+    std::vector<Point const*> points;
+    for(unsigned long long i = 0; i != ring.kept(); ++i) {
+        Point const* p = ring[i].point;
+        bool seen = false;
+        for(Point const* q : points) seen = seen || q == p;
+        if(!seen) points.push_back(p);
+    }
+
+    FILE* f = fopen(path, "wb");
+    if(!f) return false;
+    Header h;
+    memcpy(h.magic, Magic, sizeof(h.magic));
+    h.version = Version;
+    h.record_size = sizeof(Record);
+    h.written = ring.written();
+    h.records = ring.kept();
+    h.sources = static_cast<unsigned>(ring.sources().size());
+    h.points = static_cast<unsigned>(points.size());
+    fwrite(&h, sizeof(h), 1, f);
+    for(Ring::Source const& source : ring.sources()) {
+        unsigned const len = static_cast<unsigned>(source.text.size());
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(source.text.data(), 1, len, f);
+    }
+    for(Point const* p : points) {
+        PointHeader const ph = {
+            reinterpret_cast<unsigned long long>(p),
+            p->line,
+            static_cast<unsigned>(strlen(p->function)),
+            static_cast<unsigned>(strlen(p->format)) };
+        fwrite(&ph, sizeof(ph), 1, f);
+        fwrite(p->function, 1, ph.function, f);
+        fwrite(p->format, 1, ph.format, f);
+    }
+    for(unsigned long long i = 0; i != ring.kept(); ++i) {
+        Record r = ring[i];
+        r.source -= ring.dropped();
+        fwrite(&r, sizeof(r), 1, f);
+    }
+    return fclose(f) == 0;
+}
+
+} // namespace Trace
+
+} // namespace Jak
+
+#define PFMT "%P"
+#define P(X) ::Jak::Trace::State{(X).word_}
+#define TRACE(F, ...) do{\
+    static ::Jak::Trace::Point const jak_trace_point = { F, __func__, __LINE__ };\
+    ::Jak::Trace::record(jak_trace_point, ## __VA_ARGS__);\
+}while(0)
+#define DTRACE(F, ...) TRACE(PFMT ": " F, P(*this), ## __VA_ARGS__)
+#define TRACE_SOURCE(B) ::Jak::Trace::Ring::instance().source(B)
+
+#endif
@@ -48,6 +48,9 @@ enum class Code {
     RunawayString = 16,
     UnexpectedEndOfFile = 17,
     ExpectingOperand = 18,
+    SourceTooLarge = 19,
+    UndefinedLine = 20,
+    DivisionByZero = 21,
     TODO_remove_me
 };
 
@@ -65,6 +68,9 @@ JAK_ERR(ExpectingQuotes, false);
 JAK_ERR(RunawayString, false);
 JAK_ERR(UnexpectedEndOfFile, false);
 JAK_ERR(ExpectingOperand, false);
+JAK_ERR(SourceTooLarge, false);
+JAK_ERR(UndefinedLine, false);
+JAK_ERR(DivisionByZero, false);
 
 #undef JAK_ERR
 
@@ -80,6 +86,40 @@ constexpr void SyntaxCheckHelper()
     SyntaxCheck<typename decode<C>::type, line>();
 }
 
+// a Code and a line number folded into one value, so that a program only
+// needs to be parsed once to get both template arguments of
+// SyntaxCheckHelper
+constexpr unsigned long long PackResult(Code code, int line)
+{
+    return (static_cast<unsigned long long>(code) << 32)
+        | static_cast<unsigned>(line);
+}
+
+constexpr Code UnpackCode(unsigned long long packed)
+{
+    return static_cast<Code>(packed >> 32);
+}
+
+constexpr int UnpackLine(unsigned long long packed)
+{
+    return static_cast<int>(packed & 0xFFFFFFFFu);
+}
+
+// of two results for the same program, the error on the lower line, the
+// first one on the same line, and a if neither is an error
+constexpr unsigned long long FirstError(unsigned long long a, unsigned long long b)
+{
+    return UnpackCode(b) == Code::Okay ? a
+        : UnpackCode(a) == Code::Okay ? b
+        : UnpackLine(b) < UnpackLine(a) ? b : a;
+}
+
+template<unsigned long long packed>
+constexpr void SyntaxCheckPacked()
+{
+    SyntaxCheckHelper<UnpackCode(packed), UnpackLine(packed)>();
+}
+
 } // namespace Jak
 
 #endif
@@ -0,0 +1,196 @@
+/* *******************************************************
+   Copyright (c) 2016, Vlad Meșco
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   ******************************************************* */
+#ifndef VM_HPP
+#define VM_HPP
+
+#include <cstdio>
+
+namespace Jak {
+
+// why run() stopped
+enum class Stop {
+    End,
+    StepLimit,
+    StackTooDeep,
+    NoSuchLine,
+    ReturnWithoutGosub,
+    GosubTooDeep,
+    DivisionByZero,
+    NoInput,
+    TooMuchData
+};
+
+CONSTEXPR char const* name(Stop s)
+{
+    switch(s)
+    {
+    case Stop::End: return "End";
+    case Stop::StepLimit: return "StepLimit";
+    case Stop::StackTooDeep: return "StackTooDeep";
+    case Stop::NoSuchLine: return "NoSuchLine";
+    case Stop::ReturnWithoutGosub: return "ReturnWithoutGosub";
+    case Stop::GosubTooDeep: return "GosubTooDeep";
+    case Stop::DivisionByZero: return "DivisionByZero";
+    case Stop::NoInput: return "NoInput";
+    case Stop::TooMuchData: return "TooMuchData";
+    default: return "?";
+    }
+}
+
+struct RunResult
+{
+    Stop stop;
+    // instructions executed
+    unsigned long long steps;
+    // the address of the instruction it stopped at
+    unsigned address;
+};
+
+// The interpreter for bytecode.hpp, meant to be given a program that was
+// compiled at compile time. PRINT writes its items to out separated by
+// a space, INPUT reads decimal numbers from in and LIST writes the
+// source, up to its NUL. Arithmetic wraps around, as in the compiler. It
+// stops at END, at the end of the code, on an error or after steps
+// instructions; a program that needs more stack than it has does not
+// start.
+class Vm
+{
+public:
+    enum : unsigned
+    {
+        StackSize = 256,
+        GosubDepth = 256,
+        DataSize = 1024
+    };
+
+    Vm(BytecodeView const program, FILE* in, FILE* out)
+        : program_(program)
+          , in_(in)
+          , out_(out)
+          , variables_()
+          , data_size_(0)
+    {}
+
+    Value variable(char v) const { return variables_[v - 'A']; }
+    unsigned data_size() const { return data_size_; }
+    Value data(unsigned i) const { return data_[i]; }
+
+    RunResult run(unsigned long long const steps)
+    {
+        if(program_.stack() > StackSize) return {Stop::StackTooDeep, 0, 0};
+        unsigned const* const code = program_.code();
+        Value stack[StackSize];
+        unsigned sp = 0;
+        unsigned returns[GosubDepth];
+        unsigned rp = 0;
+        bool separate = false;
+        unsigned pc = 0;
+        unsigned long long n = 0;
+        for(; n != steps; ++n) {
+            unsigned const at = pc++;
+            unsigned const i = code[at];
+            unsigned const a = arg(i);
+            switch(op(i))
+            {
+            case Op::Push: stack[sp++] = static_cast<Value>(a); break;
+            case Op::Constant: stack[sp++] = static_cast<Value>(program_.numbers()[a]); break;
+            case Op::Load: stack[sp++] = variables_[a]; break;
+            case Op::Negate: stack[sp - 1] = wrap(0u - static_cast<unsigned>(stack[sp - 1])); break;
+            case Op::Add: --sp; stack[sp - 1] = wrap(static_cast<unsigned>(stack[sp - 1]) + static_cast<unsigned>(stack[sp])); break;
+            case Op::Subtract: --sp; stack[sp - 1] = wrap(static_cast<unsigned>(stack[sp - 1]) - static_cast<unsigned>(stack[sp])); break;
+            case Op::Multiply: --sp; stack[sp - 1] = wrap(static_cast<unsigned>(stack[sp - 1]) * static_cast<unsigned>(stack[sp])); break;
+            case Op::Divide:
+                --sp;
+                if(stack[sp] == 0) return {Stop::DivisionByZero, n, at};
+                // the one quotient that does not fit
+                if(stack[sp] == -1) stack[sp - 1] = wrap(0u - static_cast<unsigned>(stack[sp - 1]));
+                else stack[sp - 1] /= stack[sp];
+                break;
+            case Op::Compare: --sp; stack[sp - 1] = compare(static_cast<AstRelop>(a), stack[sp - 1], stack[sp]); break;
+            case Op::JumpUnless: if(stack[--sp] == 0) pc = a; break;
+            case Op::Store: variables_[a] = stack[--sp]; break;
+            case Op::Input:
+                if(!in_ || fscanf(in_, "%d", &variables_[a]) != 1) return {Stop::NoInput, n, at};
+                break;
+            case Op::PrintString:
+                if(separate) fputc(' ', out_);
+                fwrite(program_.source() + program_.strings()[2 * a], 1, program_.strings()[2 * a + 1], out_);
+                separate = true;
+                break;
+            case Op::PrintValue:
+                if(separate) fputc(' ', out_);
+                fprintf(out_, "%d", stack[--sp]);
+                separate = true;
+                break;
+            case Op::PrintLine: fputc('\n', out_); separate = false; break;
+            case Op::Data:
+                if(data_size_ == DataSize) return {Stop::TooMuchData, n, at};
+                data_[data_size_++] = stack[--sp];
+                break;
+            case Op::Gosub:
+                if(rp == GosubDepth) return {Stop::GosubTooDeep, n, at};
+                returns[rp++] = pc;
+                // fall through
+            case Op::Goto:
+                pc = program_.address(stack[--sp]);
+                if(pc == BytecodeSizes::NoLine) return {Stop::NoSuchLine, n, at};
+                break;
+            case Op::Call:
+                if(rp == GosubDepth) return {Stop::GosubTooDeep, n, at};
+                returns[rp++] = pc;
+                // fall through
+            case Op::Jump: pc = a; break;
+            case Op::Missing: return {Stop::NoSuchLine, n, at};
+            case Op::Return:
+                if(rp == 0) return {Stop::ReturnWithoutGosub, n, at};
+                pc = returns[--rp];
+                break;
+            case Op::Clear: for(Value& v : variables_) v = 0; break;
+            case Op::List: fputs(program_.source(), out_); break;
+            case Op::Run: pc = 0; sp = 0; rp = 0; break;
+            case Op::End: return {Stop::End, n + 1, at};
+            }
+        }
+        return {Stop::StepLimit, n, pc};
+    }
+
+private:
+    static Value wrap(unsigned v)
+    {
+        return static_cast<Value>(v);
+    }
+
+    BytecodeView program_;
+    FILE* in_;
+    FILE* out_;
+    Value variables_[26];
+    unsigned data_size_;
+    Value data_[DataSize];
+};
+
+} // namespace Jak
+
+#endif
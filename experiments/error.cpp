@@ -35,12 +35,12 @@ struct Result
           , err(e)
     {}
     Result(std::deque<char> i)
-        : err(Errors::None)
-          , in(i)
+        : in(i)
+          , err(Errors::None)
     {}
     Result(std::deque<char> i, Errors e)
-        : err(e)
-          , in(i)
+        : in(i)
+          , err(e)
     {}
 
     friend std::ostream& operator<<(std::ostream&, Result const&);
@@ -61,6 +61,7 @@ std::ostream& operator<<(std::ostream& fout, Result const& r)
                 throw std::invalid_argument("what");
         }
     }
+    return fout;
 }
 
 // Generic parser type
@@ -76,8 +77,8 @@ struct Parser
     }
 
     Parser(Result r, std::function<Parser(std::deque<char>)> f = nullptr)
-        : result(r)
-          , cont(f)
+        : cont(f)
+          , result(r)
     {}
 
 private:
@@ -282,6 +283,8 @@ int main()
             std::cout << "FAIL:    " << std::setw(10) << std::left << i.first << "\t:: Returned: " << r << std::setw(0) << " Expected: " << i.second << std::endl;
         }
     }
+
+    return 0;
 }
 
 /*
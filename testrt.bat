@@ -1,34 +1,18 @@
 @echo off
 SETLOCAL
 
-IF #%1 == # GOTO :NOFILE
-SET testName=%1
-
-IF #%2 == # GOTO :LOUD
-IF #%2 == #noinfo GOTO :SILENT
-
-GOTO :BADCANRY
-IF #%3 NEQ # GOTO :BADCANRY
-
-:LOUD
-SET ADDOPTS=-DPRINT_INFO
-GOTO :EXEC
-
-:SILENT
-GOTO :EXEC
-
-:EXEC
+REM testrt [trace] [-v] [-r repeats] [case...]
+REM all the cases of bits/test_cases.hpp by default, or the ones given by
+REM number or by a part of their name; trace builds with the parser trace
+REM on stderr, which makes the timings of -r meaningless
 
 SET cppName=bits/test_rt.cpp
+SET ADDOPTS=-O2 -DJAK_NO_TRACE
 
-g++ --std=gnu++14 -g -I. -I./bits -DTEST=%testName% %ADDOPTS% %cppName% && a
+IF #%1 NEQ #trace GOTO :EXEC
+SET ADDOPTS=-g
+SHIFT
 
-GOTO :EOF
-
-:NOFILE
-ECHO testrt ^<num^> [noinfo]
-EXIT /B 255
+:EXEC
 
-:BADCANRY
-ECHO testrt ^<num^> [noinfo]
-EXIT /B 255
+g++ --std=gnu++14 -I. -I./bits %ADDOPTS% %cppName% -o test_rt && test_rt %1 %2 %3 %4 %5 %6 %7 %8 %9
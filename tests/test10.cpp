@@ -0,0 +1,147 @@
+#define JAK_BYTECODE
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+#include <bits/vm.hpp>
+
+#define PROGRAM "\
+10 LET X = 1 + 2 * 3\n\
+20 IF X > 5 THEN PRINT \"big\", X\n\
+30 GOSUB 50\n\
+40 END\n\
+50 RETURN\n"
+
+using Jak::Op;
+
+// What TinyBasic(PROGRAM) compiles to, instruction by instruction.
+constexpr auto tree = TinyBasicAst(PROGRAM);
+constexpr auto bytecode = Jak::compile<Jak::bytecode_words(tree, Jak::Buf(PROGRAM))>(tree, Jak::Buf(PROGRAM));
+constexpr Jak::BytecodeView view {bytecode.words, PROGRAM};
+constexpr unsigned const* code = view.code();
+
+static_assert(view.size() == 18, "one End more than the program has");
+static_assert(view.stack() == 3, "1, 2 and 3 are on the stack before the first operator");
+static_assert(view.number_count() == 0, "small numbers are pushed directly");
+static_assert(view.string_count() == 1 && PROGRAM[view.strings()[0]] == 'b' && view.strings()[1] == 3, "\"big\"");
+static_assert(view.line_count() == 5, "one entry per numbered line");
+static_assert(view.lines()[2] == 20 && view.lines()[3] == 6, "line 20 starts at 6");
+static_assert(view.lines()[8] == 50 && view.lines()[9] == 16, "line 50 starts at 16");
+
+static_assert(view.dense() == 41 && view.first_line() == 10, "10 to 50 are dense enough for a table");
+static_assert(view.address(20) == 6 && view.address(50) == 16, "jumps look their line up directly");
+static_assert(view.address(21) == Jak::BytecodeSizes::NoLine && view.address(60) == Jak::BytecodeSizes::NoLine,
+        "between and after the lines");
+
+#define SPARSE "\
+1000 GOTO 1\n\
+1 END\n\
+5 RETURN\n\
+1 RETURN\n"
+
+constexpr auto sparse_tree = TinyBasicAst(SPARSE);
+constexpr auto sparse = Jak::compile<Jak::bytecode_words(sparse_tree, Jak::Buf(SPARSE))>(sparse_tree, Jak::Buf(SPARSE));
+constexpr Jak::BytecodeView sparse_view {sparse.words, SPARSE};
+static_assert(sparse_view.dense() == 0 && sparse_view.sorted() == 4, "1 to 1000 is too sparse for a table");
+static_assert(sparse_view.index()[0] == 1 && sparse_view.index()[2] == 1 && sparse_view.index()[4] == 5,
+        "sorted by line number");
+static_assert(sparse_view.address(1) == 1 && sparse_view.address(5) == 2 && sparse_view.address(1000) == 0,
+        "the first of two lines 1 wins");
+static_assert(sparse_view.address(2) == Jak::BytecodeSizes::NoLine, "no line 2");
+static_assert(Jak::op(sparse_view.code()[0]) == Op::Jump && Jak::arg(sparse_view.code()[0]) == 1,
+        "GOTO 1 goes straight to the first line 1");
+
+// Jumps to a literal that is no line are left for the VM to stop at;
+// TinyBasic(S) does not let them compile.
+#define MISSING "\
+10 GOSUB (+20)\n\
+20 GOTO 40\n\
+30 GOTO 15 + 15\n"
+
+constexpr auto missing_tree = TinyBasicAst(MISSING);
+constexpr auto missing = Jak::compile<Jak::bytecode_words(missing_tree, Jak::Buf(MISSING))>(missing_tree, Jak::Buf(MISSING));
+constexpr Jak::BytecodeView missing_view {missing.words, MISSING};
+static_assert(Jak::op(missing_view.code()[0]) == Op::Call && Jak::arg(missing_view.code()[0]) == 1,
+        "a sign and parentheses still make a literal");
+static_assert(Jak::op(missing_view.code()[1]) == Op::Missing, "no line 40");
+static_assert(Jak::op(missing_view.code()[5]) == Op::Goto, "15 + 15 is looked up when it runs");
+static_assert(Jak::checked_file<4>(Jak::Buf(MISSING))
+        == Jak::PackResult(Jak::Code::UndefinedLine, 2), "GOTO 40 on line 2");
+
+// Once a program has parsed, the error on its lowest line is the one
+// reported, whichever check finds it.
+#define LITERAL_FIRST "\
+10 IF 1 = 2 THEN GOTO 999\n\
+20 PRINT 1 / 0\n"
+#define FOLDED_FIRST "\
+10 GOSUB 5 * 3\n\
+20 PRINT 1 / 0\n\
+30 GOTO 999\n"
+#define DIVISION_FIRST "\
+10 PRINT 1 / 0\n\
+20 GOTO 999\n"
+static_assert(Jak::optimized<sizeof(LITERAL_FIRST), 3>(Jak::Buf(LITERAL_FIRST)).result
+        == Jak::PackResult(Jak::Code::UndefinedLine, 1), "GOTO 999, even with its IF folded away");
+static_assert(Jak::optimized<sizeof(FOLDED_FIRST), 4>(Jak::Buf(FOLDED_FIRST)).result
+        == Jak::PackResult(Jak::Code::UndefinedLine, 1), "GOSUB 15");
+static_assert(Jak::optimized<sizeof(DIVISION_FIRST), 3>(Jak::Buf(DIVISION_FIRST)).result
+        == Jak::PackResult(Jak::Code::DivisionByZero, 1), "1 / 0 before GOTO 999");
+
+// Folded, as TinyBasic(S) compiles it: constants are pushed as one, and
+// an IF with a constant condition leaves its statement or nothing.
+#define FOLDED "\
+10 LET X = 1 + 2 * 3\n\
+20 IF 2 * 3 > 5 THEN GOTO 40\n\
+30 IF 1 = 2 THEN PRINT X\n\
+40 PRINT -X / (4 - 1 - 1)\n"
+
+constexpr auto folded_tree = Jak::folded<sizeof(FOLDED)>(Jak::Buf(FOLDED));
+constexpr auto folded = Jak::compile<Jak::bytecode_words(folded_tree, Jak::Buf(FOLDED))>(folded_tree, Jak::Buf(FOLDED));
+constexpr Jak::BytecodeView folded_view {folded.words, FOLDED};
+static_assert(folded_view.size() == 10, "2 for line 10, 1 for 20, 0 for 30, 6 for 40 and the End");
+static_assert(Jak::op(folded_view.code()[0]) == Op::Push && Jak::arg(folded_view.code()[0]) == 7, "LET X = 7");
+static_assert(Jak::op(folded_view.code()[2]) == Op::Jump && Jak::arg(folded_view.code()[2]) == 3, "GOTO 40");
+static_assert(folded_view.address(30) == 3 && folded_view.address(40) == 3, "line 30 is empty");
+static_assert(Jak::op(folded_view.code()[4]) == Op::Push && Jak::arg(folded_view.code()[4]) == 2
+        && Jak::op(folded_view.code()[6]) == Op::Negate, "-(X / 2)");
+
+// Optimized, GOSUB 40 goes straight on to line 50 through the GOTOs,
+// and only lines 10, 20 and 50 are left.
+#define CHAINS "\
+10 GOSUB 40\n\
+20 END\n\
+30 PRINT \"never\"\n\
+40 GOTO 60\n\
+50 RETURN\n\
+60 GOTO 50\n\
+70 LET X = 1\n"
+
+constexpr auto chains_tree = Jak::optimized<sizeof(CHAINS), Jak::line_bound(Jak::Buf(CHAINS))>(Jak::Buf(CHAINS));
+constexpr auto chains = Jak::compile<Jak::bytecode_words(chains_tree, Jak::Buf(CHAINS))>(chains_tree, Jak::Buf(CHAINS));
+constexpr Jak::BytecodeView chains_view {chains.words, CHAINS};
+static_assert(chains_view.size() == 4 && chains_view.removed() == 4, "Call, End, Return and the End after the last line");
+static_assert(Jak::op(chains_view.code()[0]) == Op::Call && Jak::arg(chains_view.code()[0]) == 2, "GOSUB 50");
+static_assert(chains_view.line_count() == 7 && chains_view.lines()[5] == Jak::BytecodeSizes::NoLine,
+        "line 30 is still listed, without an address");
+static_assert(chains_view.address(50) == 2 && chains_view.address(40) == Jak::BytecodeSizes::NoLine,
+        "only the lines left are in the index");
+
+static_assert(Jak::op(code[0]) == Op::Push && Jak::arg(code[0]) == 1, "LET X = 1");
+static_assert(Jak::op(code[3]) == Op::Multiply && Jak::op(code[4]) == Op::Add, "+ 2 * 3");
+static_assert(Jak::op(code[5]) == Op::Store && Jak::arg(code[5]) == 'X' - 'A', "into X");
+static_assert(Jak::op(code[8]) == Op::Compare
+        && Jak::arg(code[8]) == static_cast<unsigned>(Jak::AstRelop::Gt), "IF X > 5");
+static_assert(Jak::op(code[9]) == Op::JumpUnless && Jak::arg(code[9]) == 14, "THEN skips the PRINT");
+static_assert(Jak::op(code[10]) == Op::PrintString && Jak::op(code[12]) == Op::PrintValue
+        && Jak::op(code[13]) == Op::PrintLine, "PRINT \"big\", X");
+static_assert(Jak::op(code[14]) == Op::Call && Jak::arg(code[14]) == 16, "GOSUB 50, to where line 50 starts");
+static_assert(Jak::op(code[15]) == Op::End && Jak::op(code[16]) == Op::Return && Jak::op(code[17]) == Op::End,
+        "END, RETURN, and the End after the last line");
+
+int main()
+{
+    TinyBasicProgram const program = TinyBasic(PROGRAM);
+    Execute(program);
+    Jak::Vm vm(program.code, nullptr, stdout);
+    Jak::RunResult const r = vm.run(1000);
+    printf("%s after %llu instructions\n", Jak::name(r.stop), r.steps);
+    return r.stop == Jak::Stop::End && r.steps == 13 ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+
+int main()
+{
+    Execute(TinyBasic("\
+10 PRINT 'Hello, World!'\n\
+20 IF X < 3 THEN GOSUB 30\n\
+30 GOTO (15)\n"));
+}
@@ -0,0 +1,11 @@
+#define JAK_BYTECODE
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+
+int main()
+{
+    Execute(TinyBasic("\
+10 LET X = 3\n\
+20 IF X > 2 THEN LET Y = X / (2 - 2)\n\
+30 PRINT Y\n"));
+}
@@ -0,0 +1,10 @@
+#define JAK_BYTECODE
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+
+int main()
+{
+    Execute(TinyBasic("\
+10 PRINT 1\n\
+20 GOTO 15 + 15\n"));
+}
@@ -0,0 +1,52 @@
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+
+#define PROGRAM "\
+10 PRINT \"A\", X\n\
+20 IF X < 3 THEN GOTO 10\n\
+END\n"
+
+using Jak::Keyword;
+using Jak::TokenKind;
+
+// The tokens of the program below, one by one. A newline counts for the
+// line it ends, and EndOfFile is on the line after the last one.
+constexpr auto tokens = Jak::tokenize(PROGRAM);
+static_assert(tokens.size == 18, "EndOfFile is the 18th token");
+
+constexpr bool is(unsigned i, TokenKind kind, int line, Keyword keyword = Keyword::None)
+{
+    return tokens.tokens[i].kind == kind
+        && tokens.tokens[i].line == line
+        && tokens.tokens[i].keyword == keyword;
+}
+
+// where the text of token i starts, and how long it is
+constexpr bool at(unsigned i, long offset, long length)
+{
+    return tokens.tokens[i].begin - PROGRAM == offset
+        && tokens.tokens[i].end - tokens.tokens[i].begin == length;
+}
+
+static_assert(is(0, TokenKind::Number, 1) && at(0, 0, 2), "10");
+static_assert(is(1, TokenKind::Keyword, 1, Keyword::PRINT) && at(1, 3, 5), "PRINT");
+static_assert(is(2, TokenKind::String, 1) && at(2, 9, 3), "a string, with its quotes");
+static_assert(is(3, TokenKind::Punct, 1) && is(4, TokenKind::Variable, 1), ", X");
+static_assert(is(5, TokenKind::Newline, 1) && at(5, 15, 1), "the end of line 1");
+
+static_assert(is(6, TokenKind::Number, 2) && is(7, TokenKind::Keyword, 2, Keyword::IF), "20 IF");
+static_assert(is(8, TokenKind::Variable, 2) && is(9, TokenKind::Relop, 2)
+        && is(10, TokenKind::Number, 2), "X < 3");
+static_assert(is(11, TokenKind::Keyword, 2, Keyword::THEN), "a keyword after an operand");
+static_assert(is(12, TokenKind::Keyword, 2, Keyword::GOTO), "a keyword after THEN");
+static_assert(is(13, TokenKind::Number, 2) && at(13, 38, 2), "10");
+static_assert(is(14, TokenKind::Newline, 2), "the end of line 2");
+
+static_assert(is(15, TokenKind::Keyword, 3, Keyword::END), "a line without a number");
+static_assert(is(16, TokenKind::Newline, 3) && is(17, TokenKind::EndOfFile, 4) && at(17, 45, 0),
+        "nothing after the last newline");
+
+int main()
+{
+    Execute(TinyBasic(PROGRAM));
+}
@@ -0,0 +1,25 @@
+#define JAK_PROFILE
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+
+#define PROGRAM "\
+10 LET X = 1 + 2 * (3 - A)\n\
+20 IF X > 10 THEN PRINT \"big\", X\n\
+30 GOTO 10\n"
+
+// What the program below costs to validate. A grammar change that makes
+// these go up should have a good reason to; when they go down, lower
+// them.
+constexpr Jak::Profile cost = TinyBasicProfile(PROGRAM);
+static_assert(cost.calls(Jak::RuleId::Line) == 3, "one line() per line");
+static_assert(cost.calls(Jak::RuleId::Statement) == 4, "IF ... THEN nests a statement");
+static_assert(cost.calls() <= 50, "validating got more expensive");
+static_assert(cost.chars() <= 72, "validating reads more characters");
+static_assert(cost.failed(Jak::RuleId::NumberedLine) == 0, "every line is numbered");
+static_assert(cost.failed(Jak::RuleId::String) == 1, "X is tried as a string first");
+static_assert(cost.discarded(Jak::RuleId::String) <= 1, "backtracking throws more away");
+
+int main()
+{
+    Execute(TinyBasic(PROGRAM));
+}
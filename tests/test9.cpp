@@ -0,0 +1,49 @@
+#define JAK_AST
+#include <TinyBasicProgram.hpp>
+#include <TestUtils.h>
+
+#define PROGRAM "\
+10 LET X = 1 + 2 * (3 - A)\n\
+20 IF X > 10 THEN PRINT \"big\", -X\n\
+30 GOTO 10\n"
+
+using Jak::AstKind;
+using Jak::AstNode;
+
+// The tree of the program below, node by node. Children come first, so
+// the lines end at 10, 21 and 25.
+constexpr auto tree = TinyBasicAst(PROGRAM);
+static_assert(Jak::UnpackCode(tree.result) == Jak::Code::Okay, "the program is valid");
+static_assert(!tree.overflow, "sizeof(PROGRAM) nodes are enough");
+static_assert(tree.size == 26, "one node per number, variable, operator and string");
+
+static_assert(tree.first == 10 && tree[10].kind == AstKind::Line && tree[10].op == 1, "line 10");
+static_assert(tree[10].child == 0 && tree[0].kind == AstKind::Number && tree[0].child == 2, "labelled 10");
+static_assert(tree[0].next == 9 && tree[9].kind == AstKind::Statement
+        && tree[9].op == static_cast<unsigned char>(Jak::Keyword::LET), "LET");
+static_assert(tree[9].child == 1 && tree[1].kind == AstKind::Var
+        && PROGRAM[tree[1].offset] == 'X', "LET X");
+static_assert(tree[1].next == 8 && tree[8].kind == AstKind::Binary && tree[8].op == '+', "= ... + ...");
+static_assert(tree[8].child == 2 && tree[2].next == 7 && tree[7].op == '*', "* binds tighter");
+static_assert(tree[7].child == 3 && tree[3].next == 6 && tree[6].op == '-', "parentheses leave no node");
+static_assert(tree[6].child == 4 && tree[4].next == 5 && tree[5].next == AstNode::None, "(3 - A)");
+
+static_assert(tree[10].next == 21 && tree[21].child == 11 && tree[11].next == 20, "line 20");
+static_assert(tree[20].op == static_cast<unsigned char>(Jak::Keyword::IF) && tree[20].child == 13, "IF");
+static_assert(tree[13].kind == AstKind::Relop && tree[13].op == static_cast<unsigned char>(Jak::AstRelop::Gt)
+        && tree[13].child == 12 && tree[12].next == 14, "X > 10");
+static_assert(tree[13].next == 19 && tree[19].op == static_cast<unsigned char>(Jak::Keyword::PRINT),
+        "THEN PRINT");
+static_assert(tree[19].child == 18 && tree[18].kind == AstKind::List && tree[18].child == 15, "a list");
+static_assert(tree[15].kind == AstKind::String && tree[15].child == 3
+        && PROGRAM[tree[15].offset] == 'b', "the text of a string, without its quotes");
+static_assert(tree[15].next == 17 && tree[17].kind == AstKind::Negate && tree[17].child == 16, "-X");
+
+static_assert(tree[21].next == 25 && tree[25].child == 22 && tree[22].next == 24
+        && tree[24].child == 23 && tree[23].kind == AstKind::Number, "GOTO 10");
+static_assert(tree[25].next == AstNode::None, "the last line");
+
+int main()
+{
+    Execute(TinyBasic(PROGRAM));
+}
@@ -0,0 +1,232 @@
+#if 0
+goal: turn a binary trace written by bits/trace.hpp back into text
+compile with g++ --std=gnu++14 -O2 -I. -I./bits tools/trace.cpp -o trace
+run as ./trace [--chrome] [--clip n] trace.jtr > trace.txt
+
+Build a runtime program with -DJAK_TRACE_RING and have it call
+Trace::dump(). bits/test_rt.cpp does: built with
+
+    g++ --std=gnu++14 -I. -I./bits -DJAK_TRACE_RING bits/test_rt.cpp -o test_rt
+
+it writes <case>.jtr into the current directory for every case it runs.
+The trace mode of testrt.bat builds the fprintf backend instead, which
+writes no dumps; tracecheck.sh compares the two. Without options every
+record is printed the way the fprintf backend of parser_rt.hpp prints
+it, with the rest of the source after every parser state: the whole
+source, or the StreamParser line or parallel.hpp piece it is in.
+--clip n cuts that text after n characters, which keeps the output of a
+large source from growing with the square of its size. --chrome writes
+Chrome trace JSON instead, for chrome://tracing or Perfetto: one instant
+event per record, named after the function of the trace point, with the
+code, line, depth and offset of its first state as arguments.
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#define CONSTEXPR
+#include "buffer.hpp"
+#include "validate.hpp"
+#include "trace.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+
+using namespace Jak;
+using Trace::Record;
+
+namespace {
+
+struct Point
+{
+    int line;
+    std::string function;
+    std::string format;
+};
+
+struct Dump
+{
+    Trace::Header header;
+    std::vector<std::string> sources;
+    std::map<unsigned long long, Point> points;
+    std::vector<Record> records;
+};
+
+bool read(FILE* f, void* p, size_t n)
+{
+    return fread(p, 1, n, f) == n;
+}
+
+bool load(char const* path, Dump& d)
+{
+    FILE* f = fopen(path, "rb");
+    if(!f) {
+        perror(path);
+        return false;
+    }
+    bool ok = read(f, &d.header, sizeof(d.header))
+        && memcmp(d.header.magic, Trace::Magic, sizeof(Trace::Magic)) == 0
+        && d.header.version == Trace::Version
+        && d.header.record_size == sizeof(Record);
+    d.sources.resize(d.header.sources);
+    for(unsigned i = 0; ok && i != d.header.sources; ++i) {
+        unsigned len = 0;
+        ok = read(f, &len, sizeof(len));
+        if(!ok) break;
+        d.sources[i].resize(len);
+        ok = read(f, &d.sources[i][0], len);
+    }
+    for(unsigned i = 0; ok && i != d.header.points; ++i) {
+        Trace::PointHeader ph;
+        ok = read(f, &ph, sizeof(ph));
+        if(!ok) break;
+        Point& p = d.points[ph.id];
+        p.line = ph.line;
+        p.function.resize(ph.function);
+        p.format.resize(ph.format);
+        ok = read(f, &p.function[0], ph.function) && read(f, &p.format[0], ph.format);
+    }
+    if(ok) {
+        d.records.resize(d.header.records);
+        ok = read(f, d.records.data(), d.records.size() * sizeof(Record));
+    }
+    fclose(f);
+    if(!ok) fprintf(stderr, "%s: not a trace, or one from another build\n", path);
+    return ok;
+}
+
+struct State
+{
+    int code;
+    int line;
+    int depth;
+    unsigned offset;
+};
+
+State state(unsigned long long word)
+{
+    typedef TinyBasicParser T;
+    return {
+        static_cast<int>(word >> T::CodeShift),
+        static_cast<int>((word >> T::LineShift) & T::LineMax),
+        static_cast<int>((word >> T::DepthShift) & T::DepthMax),
+        static_cast<unsigned>(word & T::OffsetMax) };
+}
+
+// Formats a record. text(State) gives what stands for a state, the rest
+// of the conversions are the ones the trace points use.
+template<typename Text>
+std::string format(std::string const& fmt, Record const& r, Text const& text)
+{
+    std::string s;
+    unsigned a = 0;
+    for(size_t i = 0; i != fmt.size(); ++i) {
+        if(fmt[i] != '%' || i + 1 == fmt.size()) {
+            s += fmt[i];
+            continue;
+        }
+        char const c = fmt[++i];
+        unsigned long long const v = c != '%' && a < Trace::MaxArgs ? r.args[a++] : 0;
+        switch(c)
+        {
+        case 'P': s += text(state(v)); break;
+        case 'd': s += std::to_string(static_cast<int>(v)); break;
+        case 'c': s += static_cast<char>(v); break;
+        case 's': s += std::string(reinterpret_cast<char const*>(&v), strnlen(reinterpret_cast<char const*>(&v), sizeof(v))); break;
+        case '%': s += '%'; break;
+        default: s += '%'; s += c; break;
+        }
+    }
+    return s;
+}
+
+void json_string(std::string const& s)
+{
+    putchar('"');
+    for(char ch : s) {
+        unsigned char const c = static_cast<unsigned char>(ch);
+        if(c == '"' || c == '\\') printf("\\%c", c);
+        else if(c < 0x20) printf("\\u%04x", c);
+        else putchar(c);
+    }
+    putchar('"');
+}
+
+int usage(char const* self)
+{
+    fprintf(stderr, "usage: %s [--chrome] [--clip n] trace.jtr\n", self);
+    return 255;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool chrome = false;
+    size_t clip = std::string::npos;
+    char const* path = nullptr;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--chrome") == 0) chrome = true;
+        else if(strcmp(argv[i], "--clip") == 0 && i + 1 < argc) clip = static_cast<size_t>(atol(argv[++i]));
+        else if(argv[i][0] == '-' || path) return usage(argv[0]);
+        else path = argv[i];
+    }
+    if(!path) return usage(argv[0]);
+
+    Dump d;
+    if(!load(path, d)) return 1;
+    if(d.header.written != d.header.records) {
+        fprintf(stderr, "%llu older records were overwritten\n", d.header.written - d.header.records);
+    }
+
+    auto rest = [&](Record const& r, State const& st) {
+        static std::string const none;
+        std::string const& source = r.source < d.sources.size() ? d.sources[r.source] : none;
+        std::string t = st.offset < source.size() ? source.substr(st.offset) : std::string();
+        // the fprintf backend prints it with %.*s
+        t = t.substr(0, strnlen(t.c_str(), t.size()));
+        return t.size() > clip ? t.substr(0, clip) : t;
+    };
+
+    if(!chrome) {
+        for(auto&& r : d.records) {
+            Point const& p = d.points[reinterpret_cast<unsigned long long>(r.point)];
+            printf("(%d) %s", p.line, format(p.format, r, [&](State const& st) {
+                        return "[" + std::to_string(st.code) + ", " + std::to_string(st.line)
+                            + ", " + std::to_string(st.depth) + ", " + rest(r, st) + "]";
+                        }).c_str());
+        }
+        return 0;
+    }
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    unsigned long long const start = d.records.empty() ? 0 : d.records.front().time;
+    char const* sep = "\n";
+    for(auto&& r : d.records) {
+        Point const& p = d.points[reinterpret_cast<unsigned long long>(r.point)];
+        bool first = true;
+        State first_state = { 0, 0, 0, 0 };
+        std::string message = format(p.format, r, [&](State const& st) {
+                if(first) first_state = st;
+                first = false;
+                return "[" + std::to_string(st.code) + ", " + std::to_string(st.line)
+                    + ", " + std::to_string(st.depth) + ", @" + std::to_string(st.offset) + "]";
+                });
+        while(!message.empty() && message.back() == '\n') message.pop_back();
+        printf("%s{\"name\":", sep);
+        json_string(p.function);
+        printf(",\"cat\":\"parser\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{",
+                (r.time - start) / 1000.0);
+        if(!first) {
+            printf("\"code\":%d,\"line\":%d,\"depth\":%d,\"offset\":%u,",
+                    first_state.code, first_state.line, first_state.depth, first_state.offset);
+        }
+        printf("\"trace_line\":%d,\"message\":", p.line);
+        json_string(message);
+        printf("}}");
+        sep = ",\n";
+    }
+    printf("\n]}\n");
+}
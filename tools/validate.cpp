@@ -0,0 +1,349 @@
+#if 0
+goal: validate every TinyBasic program under a directory tree in one
+      process, the way a deploy checks all of them
+compile with g++ --std=gnu++14 -O2 -pthread -I. -I./bits tools/validate.cpp -o validate
+run as ./validate [-j threads] [--ext .bas] [--slowest n] path... > results.jsonl
+
+POSIX only (dirent, mmap). Every path is either a file, which is always
+validated, or a directory, which is walked for files with the extension
+(.bas unless --ext says otherwise). Symbolic links to files are followed,
+links to directories are not. The files are mapped with MappedSource,
+parsed with file(), which gathers their jumps for check_jumps(), on a
+pool of threads: each thread has a queue of its own and takes work from
+the others when it runs out. Every file gets one JSON record on stdout, in
+the order they finish:
+
+    {"path":"a/b.bas","code":12,"name":"UnknownKeyword","line":5,"bytes":812,"us":14.2}
+
+or, when the file cannot be mapped,
+
+    {"path":"a/c.bas","error":"Permission denied","bytes":0,"us":3.1}
+
+us is the time to map, parse and unmap the file. A summary goes to
+stderr: counts, throughput, latency percentiles and the slowest files.
+Built with -DJAK_PROFILE, the summary ends with the Profile of the whole
+run, which shows the rules that backtrack the most over these programs
+(see bits/profile.hpp); the time per file then includes profiling.
+The exit status is 0 when every file is valid, 1 when any is not or
+could not be read, and 255 for a bad command line.
+#endif
+#include <sys/stat.h>
+#include <dirent.h>
+#include <strings.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CONSTEXPR
+#ifdef JAK_PROFILE
+# define PROFILE_CLOCK() static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(\
+            std::chrono::steady_clock::now().time_since_epoch()).count())
+# include "profile.hpp"
+#endif
+#include "buffer.hpp"
+#include "validate.hpp"
+#include "scan.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+using namespace Jak;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+char const* name(Code code)
+{
+    switch(code)
+    {
+    case Code::Okay: return "Okay";
+    case Code::InternalError: return "InternalError";
+    case Code::ExpectingANumber: return "ExpectingANumber";
+    case Code::ExpectingEndOfLine: return "ExpectingEndOfLine";
+    case Code::UnknownKeyword: return "UnknownKeyword";
+    case Code::ExpectingRelationalOperator: return "ExpectingRelationalOperator";
+    case Code::ExpectingAVariable: return "ExpectingAVariable";
+    case Code::ExpectingQuotes: return "ExpectingQuotes";
+    case Code::RunawayString: return "RunawayString";
+    case Code::UnexpectedEndOfFile: return "UnexpectedEndOfFile";
+    case Code::ExpectingOperand: return "ExpectingOperand";
+    case Code::SourceTooLarge: return "SourceTooLarge";
+    case Code::UndefinedLine: return "UndefinedLine";
+    case Code::DivisionByZero: return "DivisionByZero";
+    default: return "Unknown";
+    }
+}
+
+struct File
+{
+    std::string path;
+    unsigned long long size;
+    // filled in by the worker that validates it
+    int error = 0;
+    unsigned long long result = 0;
+    unsigned bytes = 0;
+    double us = 0;
+#ifdef JAK_PROFILE
+    Profile profile {};
+#endif
+};
+
+bool has_extension(char const* name, std::string const& ext)
+{
+    size_t const n = strlen(name);
+    return n > ext.size() && strcasecmp(name + n - ext.size(), ext.c_str()) == 0;
+}
+
+void walk(std::string const& dir, std::string const& ext, std::vector<File>& files)
+{
+    DIR* d = opendir(dir.c_str());
+    if(!d) {
+        fprintf(stderr, "%s: %s\n", dir.c_str(), strerror(errno));
+        return;
+    }
+    while(struct dirent* e = readdir(d)) {
+        if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        std::string const path = dir + "/" + e->d_name;
+        struct stat st;
+        if(lstat(path.c_str(), &st) < 0) continue;
+        if(S_ISDIR(st.st_mode)) {
+            walk(path, ext, files);
+        } else if(has_extension(e->d_name, ext)) {
+            if(S_ISLNK(st.st_mode) && (stat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode))) continue;
+            if(S_ISREG(st.st_mode)) files.push_back(File{ path, static_cast<unsigned long long>(st.st_size) });
+        }
+    }
+    closedir(d);
+}
+
+void validate_file(File& f)
+{
+    auto const t0 = Clock::now();
+    {
+        MappedSource const source(f.path.c_str());
+        f.error = source.error();
+        f.bytes = source.buf().len();
+        if(source.ok()) {
+            unsigned const lines = line_bound(source.buf());
+            std::vector<Value> labels(lines);
+            std::vector<JumpTarget> targets(lines);
+            Jumps jumps(labels.data(), targets.data(), lines);
+#ifdef JAK_PROFILE
+            f.result = TinyBasicParser(source.buf(), &f.profile, &jumps).file().result();
+#else
+            f.result = TinyBasicParser(source.buf(), &jumps).file().result();
+#endif
+            f.result = check_jumps(f.result, jumps);
+        }
+    }
+    f.us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+}
+
+void print_json_string(FILE* out, char const* s)
+{
+    fputc('"', out);
+    for(; *s; ++s) {
+        unsigned char const c = static_cast<unsigned char>(*s);
+        if(c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if(c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+void print_record(File const& f)
+{
+    fputs("{\"path\":", stdout);
+    print_json_string(stdout, f.path.c_str());
+    if(f.error) {
+        fputs(",\"error\":", stdout);
+        print_json_string(stdout, strerror(f.error));
+    } else {
+        Code const code = UnpackCode(f.result);
+        printf(",\"code\":%d,\"name\":\"%s\",\"line\":%d",
+                static_cast<int>(code), name(code), UnpackLine(f.result));
+    }
+    printf(",\"bytes\":%u,\"us\":%.1f}\n", f.bytes, f.us);
+}
+
+// Work stealing over a list known up front. Every worker pops from the
+// back of its own queue and, once that is empty, steals from the front
+// of the others. The queues are dealt the files smallest first, so a
+// worker starts on its largest file and thieves take the small ones.
+class Scheduler
+{
+public:
+    Scheduler(std::vector<File>& files, unsigned workers)
+        : files_(files)
+          , queues_(workers)
+    {
+        std::vector<unsigned> order(files.size());
+        for(unsigned i = 0; i != order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+                return files[a].size < files[b].size;
+                });
+        for(unsigned i = 0; i != order.size(); ++i) queues_[i % workers].items.push_back(order[i]);
+    }
+
+    // runs the workers, calls done(file) under a lock as each file finishes
+    template<typename Done>
+    void run(Done const& done)
+    {
+        std::mutex done_lock;
+        auto worker = [&](unsigned self) {
+            for(unsigned i; next(self, i);) {
+                validate_file(files_[i]);
+                std::lock_guard<std::mutex> lock(done_lock);
+                done(files_[i]);
+            }
+        };
+        std::vector<std::thread> pool;
+        for(unsigned w = 1; w < queues_.size(); ++w) pool.emplace_back(worker, w);
+        worker(0);
+        for(auto& t : pool) t.join();
+    }
+
+    unsigned long stolen() const
+    {
+        return stolen_.load();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<unsigned> items;
+    };
+
+    bool next(unsigned self, unsigned& i)
+    {
+        {
+            Queue& q = queues_[self];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if(!q.items.empty()) {
+                i = q.items.back();
+                q.items.pop_back();
+                return true;
+            }
+        }
+        for(unsigned k = 1; k < queues_.size(); ++k) {
+            Queue& q = queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if(!q.items.empty()) {
+                i = q.items.front();
+                q.items.pop_front();
+                ++stolen_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<File>& files_;
+    std::vector<Queue> queues_;
+    std::atomic<unsigned long> stolen_{0};
+};
+
+double percentile(std::vector<double> const& sorted, double p)
+{
+    if(sorted.empty()) return 0;
+    size_t i = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+int usage(char const* self)
+{
+    fprintf(stderr, "usage: %s [-j threads] [--ext .bas] [--slowest n] path...\n", self);
+    return 255;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    unsigned threads = 0;
+    unsigned slowest = 10;
+    std::string ext = ".bas";
+    std::vector<char const*> paths;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if(strcmp(argv[i], "--ext") == 0 && i + 1 < argc) ext = argv[++i];
+        else if(strcmp(argv[i], "--slowest") == 0 && i + 1 < argc) slowest = static_cast<unsigned>(atoi(argv[++i]));
+        else if(argv[i][0] == '-') return usage(argv[0]);
+        else paths.push_back(argv[i]);
+    }
+    if(paths.empty()) return usage(argv[0]);
+    if(threads == 0) threads = std::thread::hardware_concurrency();
+    if(threads == 0) threads = 1;
+
+    auto const start = Clock::now();
+    std::vector<File> files;
+    for(char const* p : paths) {
+        struct stat st;
+        if(stat(p, &st) < 0) {
+            fprintf(stderr, "%s: %s\n", p, strerror(errno));
+            return 1;
+        }
+        if(S_ISDIR(st.st_mode)) walk(p, ext, files);
+        else files.push_back(File{ p, static_cast<unsigned long long>(st.st_size) });
+    }
+    auto const walked = Clock::now();
+
+    if(threads > files.size()) threads = files.empty() ? 1 : static_cast<unsigned>(files.size());
+    Scheduler scheduler(files, threads);
+    scheduler.run(&print_record);
+    auto const end = Clock::now();
+
+    unsigned invalid = 0, unreadable = 0;
+    unsigned long long bytes = 0;
+    std::vector<double> us;
+    for(auto&& f : files) {
+        if(f.error) ++unreadable;
+        else if(UnpackCode(f.result) != Code::Okay) ++invalid;
+        bytes += f.bytes;
+        us.push_back(f.us);
+    }
+    std::sort(us.begin(), us.end());
+    double const walk_s = std::chrono::duration<double>(walked - start).count();
+    double const run_s = std::chrono::duration<double>(end - walked).count();
+
+    fprintf(stderr, "files      %zu (%u invalid, %u unreadable)\n", files.size(), invalid, unreadable);
+    fprintf(stderr, "bytes      %llu\n", bytes);
+    fprintf(stderr, "threads    %u (%lu files stolen)\n", threads, scheduler.stolen());
+    fprintf(stderr, "walk       %.3f s\n", walk_s);
+    fprintf(stderr, "validate   %.3f s, %.1f MiB/s, %.0f files/s\n",
+            run_s, run_s > 0 ? bytes / run_s / (1024 * 1024) : 0.0, run_s > 0 ? files.size() / run_s : 0.0);
+    fprintf(stderr, "latency us p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+            percentile(us, 50), percentile(us, 90), percentile(us, 99), percentile(us, 99.9),
+            us.empty() ? 0.0 : us.back());
+
+    std::vector<File const*> by_time;
+    for(auto&& f : files) by_time.push_back(&f);
+    size_t const n = std::min<size_t>(slowest, by_time.size());
+    std::partial_sort(by_time.begin(), by_time.begin() + n, by_time.end(), [](File const* a, File const* b) {
+            return a->us > b->us;
+            });
+    if(n) fprintf(stderr, "slowest\n");
+    for(size_t i = 0; i != n; ++i) {
+        fprintf(stderr, "%12.1f us %10u bytes  %s\n", by_time[i]->us, by_time[i]->bytes, by_time[i]->path.c_str());
+    }
+
+#ifdef JAK_PROFILE
+    Profile total {};
+    for(auto&& f : files) total += f.profile;
+    fprintf(stderr, "\n");
+    report(stderr, total);
+#endif
+
+    return invalid || unreadable ? 1 : 0;
+}
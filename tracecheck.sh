@@ -0,0 +1,34 @@
+#!/bin/sh
+# tracecheck.sh [case...]
+# builds bits/test_rt.cpp with the fprintf trace backend and with the
+# ring buffer of bits/trace.hpp, and checks that tools/trace.cpp decodes
+# the dump of every case into the very text the fprintf backend prints
+# for it; the cases are picked as testrt.bat picks them
+
+dir=$(mktemp -d) || exit 255
+trap 'rm -rf "$dir"' EXIT
+
+g++ --std=gnu++14 -I. -I./bits bits/test_rt.cpp -o "$dir/test_rt_fprintf" &&
+g++ --std=gnu++14 -I. -I./bits -DJAK_TRACE_RING bits/test_rt.cpp -o "$dir/test_rt_ring" &&
+g++ --std=gnu++14 -O2 -I. -I./bits tools/trace.cpp -o "$dir/trace" || exit 255
+
+# a case that fails still leaves its dump
+(cd "$dir" && ./test_rt_ring "$@" > cases)
+
+same=0
+different=0
+while read -r outcome id name; do
+    case "$outcome" in PASS|FAIL) ;; *) continue ;; esac
+    "$dir/test_rt_fprintf" "$id" > /dev/null 2> "$dir/fprintf.txt"
+    "$dir/trace" "$dir/$name.jtr" > "$dir/ring.txt"
+    if cmp -s "$dir/fprintf.txt" "$dir/ring.txt"; then
+        same=$((same + 1))
+    else
+        different=$((different + 1))
+        echo "DIFFERENT $id $name"
+        diff "$dir/fprintf.txt" "$dir/ring.txt" | head -n 10
+    fi
+done < "$dir/cases"
+
+echo "$same the same, $different different"
+[ "$different" -eq 0 ]